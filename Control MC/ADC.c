@@ -0,0 +1,29 @@
+#include "ADC.h"
+#include "common_macros.h"
+#include <avr/io.h>
+
+void ADC_init(void)
+{
+    /* AVCC reference (REFS0), right adjusted result, channel 0 */
+    ADMUX = (1<<REFS0);
+
+    /* Enable the ADC with the F_CPU/64 clock, no interrupt */
+    ADCSRA = (1<<ADEN) | (1<<ADPS2) | (1<<ADPS1);
+}
+
+void ADC_deInit(void)
+{
+    ADCSRA = 0;
+}
+
+uint16 ADC_readChannel(uint8 channel)
+{
+    /* Keep the reference bits, select the channel (MUX4:0) */
+    ADMUX = (ADMUX & 0xE0) | (channel & 0x1F);
+
+    /* Start the conversion, ADSC is cleared by hardware once it is done */
+    SET_BIT(ADCSRA, ADSC);
+    while(BIT_IS_SET(ADCSRA, ADSC));
+
+    return ADC;
+}
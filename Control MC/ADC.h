@@ -0,0 +1,46 @@
+#ifndef ADC_H_
+#define ADC_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Internal 1.22 V bandgap reference, read without any pin */
+#define ADC_BANDGAP_CHANNEL     0x1E
+
+/*
+ * AVCC reference, ADC clock F_CPU/64 (125 kHz at 8 MHz, within the 50-200 kHz
+ * range of full resolution), one conversion takes 13 ADC clocks.
+ */
+#define ADC_PRESCALER_VALUE     64UL
+
+#if ((F_CPU / ADC_PRESCALER_VALUE) < 50000UL) || ((F_CPU / ADC_PRESCALER_VALUE) > 200000UL)
+#error "The ADC clock is out of the 50-200 kHz range at this F_CPU"
+#endif
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Enable the ADC with the AVCC reference.
+ */
+void ADC_init(void);
+
+/*
+ * Description :
+ * Disable the ADC, it draws current while enabled.
+ */
+void ADC_deInit(void);
+
+/*
+ * Description :
+ * Run one conversion of a channel (ADMUX MUX value) and wait for it.
+ * Returns the 10-bit result.
+ */
+uint16 ADC_readChannel(uint8 channel);
+
+#endif /* ADC_H_ */
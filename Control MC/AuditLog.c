@@ -0,0 +1,238 @@
+#include "AuditLog.h"
+#include "CRC.h"
+#include "Timer.h"
+
+/* Records read per EEPROM transaction while looking for the end of the log */
+#define AUDIT_SCAN_RECORDS    8
+#define AUDIT_RING_MASK       (AUDIT_RING_SIZE - 1)
+#define AUDIT_PAGE_RECORDS    (EEPROM_PAGE_SIZE / AUDIT_RECORD_SIZE)
+
+/* A page write that failed is submitted again this many times before its records are dropped */
+#define AUDIT_WRITE_RETRIES   2
+
+/* Staged records, already encoded, indices are free running */
+static uint8 g_ring[AUDIT_RING_SIZE][AUDIT_RECORD_SIZE];
+static uint8 g_ringHead = 0;
+static uint8 g_ringTail = 0;
+static uint16 g_stagedTick = 0;   /* When the oldest staged record was recorded */
+static uint8 g_dropped = 0;
+
+/* EEPROM slot of the oldest staged record and sequence of the next record */
+static uint8 g_slot = 0;
+static uint8 g_sequence = 0;
+
+/* Page write in flight and its data, its records stay in the ring until it succeeded */
+static TWI_TransactionType g_writeTransaction = { 0 };
+static uint8 g_page[EEPROM_PAGE_SIZE];
+static uint8 g_writeCount = 0;
+static uint8 g_writeRetries = 0;
+
+static void AuditLog_write(boolean force);
+
+static void AuditLog_drop(uint8 count)
+{
+	uint16 dropped = (uint16)g_dropped + count;
+
+	g_dropped = (dropped > 0xFF) ? 0xFF : (uint8)dropped;
+}
+
+static boolean AuditLog_isValid(const uint8 *record)
+{
+	return CRC8_compute(record, AUDIT_CRC_OFFSET) == record[AUDIT_CRC_OFFSET];
+}
+
+void AuditLog_init(void)
+{
+	uint8 records[AUDIT_SCAN_RECORDS * AUDIT_RECORD_SIZE];
+	uint8 slot;
+	uint8 i;
+	uint8 *record;
+	boolean found = FALSE;
+
+	g_ringHead = g_ringTail = 0;
+	g_slot = 0;
+	g_sequence = 0;
+
+	/* The newest record is the valid one with the highest sequence number */
+	for (slot = 0; slot < AUDIT_LOG_SLOTS; slot += AUDIT_SCAN_RECORDS)
+	{
+		if (EEPROM_readBlock(EEPROM_AUDIT_LOG_START + (uint16)slot * AUDIT_RECORD_SIZE,
+				records, sizeof(records)) == ERROR)
+		{
+			continue;
+		}
+		for (i = 0; i < AUDIT_SCAN_RECORDS; ++i)
+		{
+			record = &records[i * AUDIT_RECORD_SIZE];
+			if (!AuditLog_isValid(record))
+			{
+				continue;
+			}
+			if (!found || ((sint8)(record[AUDIT_SEQUENCE_OFFSET] - (uint8)(g_sequence - 1)) > 0))
+			{
+				g_sequence = (uint8)(record[AUDIT_SEQUENCE_OFFSET] + 1);
+				g_slot = (uint8)((slot + i + 1) % AUDIT_LOG_SLOTS);
+				found = TRUE;
+			}
+		}
+	}
+}
+
+void AuditLog_record(uint8 event, uint16 user)
+{
+	uint8 *record;
+	uint32 time = Timer_getSeconds();
+
+	if ((uint8)(g_ringHead - g_ringTail) == AUDIT_RING_SIZE)
+	{
+		AuditLog_drop(1);
+		return;
+	}
+	if (g_ringHead == g_ringTail)
+	{
+		g_stagedTick = Timer_getTicks();
+	}
+
+	record = g_ring[g_ringHead & AUDIT_RING_MASK];
+	record[AUDIT_SEQUENCE_OFFSET] = g_sequence++;
+	record[AUDIT_EVENT_OFFSET] = event;
+	record[AUDIT_USER_OFFSET] = (uint8)user;
+	record[AUDIT_USER_OFFSET + 1] = (uint8)(user >> 8);
+	record[AUDIT_TIME_OFFSET] = (uint8)time;
+	record[AUDIT_TIME_OFFSET + 1] = (uint8)(time >> 8);
+	record[AUDIT_TIME_OFFSET + 2] = (uint8)(time >> 16);
+	record[AUDIT_CRC_OFFSET] = CRC8_compute(record, AUDIT_CRC_OFFSET);
+	g_ringHead++;
+
+	AuditLog_write(FALSE);
+}
+
+/*
+ * Retire the page write that finished, then queue the next page worth of staged
+ * records, a partial page only when forced or once it waited AUDIT_FLUSH_DELAY_MS.
+ */
+static void AuditLog_write(boolean force)
+{
+	uint8 staged;
+	uint8 count;
+	uint8 i, j;
+
+	if ((g_writeTransaction.status == TWI_PENDING) || (g_writeTransaction.status == TWI_BUSY))
+	{
+		return;
+	}
+
+	if (g_writeCount != 0)
+	{
+		if (g_writeTransaction.status == TWI_DONE)
+		{
+			g_slot = (uint8)((g_slot + g_writeCount) % AUDIT_LOG_SLOTS);
+		}
+		else if (g_writeRetries < AUDIT_WRITE_RETRIES)
+		{
+			/* g_page still holds the records, write it again to the same slots */
+			g_writeRetries++;
+			EEPROM_submitPageWrite(&g_writeTransaction,
+					EEPROM_AUDIT_LOG_START + (uint16)g_slot * AUDIT_RECORD_SIZE,
+					g_page, g_writeCount * AUDIT_RECORD_SIZE, NULL_PTR);
+			return;
+		}
+		else
+		{
+			/* Give up, the slots are reused by the next records */
+			AuditLog_drop(g_writeCount);
+		}
+		g_ringTail += g_writeCount;
+		g_writeCount = 0;
+		g_writeRetries = 0;
+	}
+
+	staged = (uint8)(g_ringHead - g_ringTail);
+	if (staged == 0)
+	{
+		return;
+	}
+
+	/* Batch the staged records that share the page of the next slot */
+	count = AUDIT_PAGE_RECORDS - (g_slot % AUDIT_PAGE_RECORDS);
+	if (staged < count)
+	{
+		/* Keep filling the page unless the oldest record waited long enough */
+		if (!force && ((uint16)(Timer_getTicks() - g_stagedTick) < AUDIT_FLUSH_DELAY_MS))
+		{
+			return;
+		}
+		count = staged;
+	}
+
+	for (i = 0; i < count; ++i)
+	{
+		for (j = 0; j < AUDIT_RECORD_SIZE; ++j)
+		{
+			g_page[i * AUDIT_RECORD_SIZE + j] = g_ring[(uint8)(g_ringTail + i) & AUDIT_RING_MASK][j];
+		}
+	}
+	if (EEPROM_submitPageWrite(&g_writeTransaction,
+			EEPROM_AUDIT_LOG_START + (uint16)g_slot * AUDIT_RECORD_SIZE,
+			g_page, count * AUDIT_RECORD_SIZE, NULL_PTR) == 0)
+	{
+		return;   /* TWI queue full, retry on the next call */
+	}
+	g_writeCount = count;
+	g_stagedTick = Timer_getTicks();
+}
+
+void AuditLog_service(void)
+{
+	/* Recording the loss needs a free ring entry, else it would only add to the count */
+	if ((g_dropped != 0) && ((uint8)(g_ringHead - g_ringTail) < AUDIT_RING_SIZE))
+	{
+		AuditLog_record(AUDIT_DROPPED, AuditLog_takeDropped());
+		return;
+	}
+	AuditLog_write(FALSE);
+}
+
+void AuditLog_flush(void)
+{
+	while (g_ringHead != g_ringTail)
+	{
+		TWI_wait(&g_writeTransaction);
+		AuditLog_write(TRUE);
+	}
+	TWI_wait(&g_writeTransaction);
+}
+
+uint8 AuditLog_submitRead(TWI_TransactionType *transaction, uint16 index, uint8 *buffer, uint8 count)
+{
+	uint8 slot;
+
+	if (index >= AUDIT_LOG_SLOTS)
+	{
+		return 0;
+	}
+	if (count > AUDIT_LOG_SLOTS - index)
+	{
+		count = (uint8)(AUDIT_LOG_SLOTS - index);
+	}
+
+	/* The next slot to be written holds the oldest record */
+	slot = (uint8)((g_slot + index) % AUDIT_LOG_SLOTS);
+	if (count > AUDIT_LOG_SLOTS - slot)
+	{
+		count = (uint8)(AUDIT_LOG_SLOTS - slot);
+	}
+	if (!EEPROM_submitRead(transaction, EEPROM_AUDIT_LOG_START + (uint16)slot * AUDIT_RECORD_SIZE,
+			buffer, (uint16)count * AUDIT_RECORD_SIZE, NULL_PTR))
+	{
+		return 0;
+	}
+	return count;
+}
+
+uint8 AuditLog_takeDropped(void)
+{
+	uint8 dropped = g_dropped;
+	g_dropped = 0;
+	return dropped;
+}
@@ -0,0 +1,104 @@
+#ifndef AUDITLOG_H_
+#define AUDITLOG_H_
+
+#include "std_types.h"
+#include "EEPROM.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Circular event log in the EEPROM, the oldest records are overwritten.
+ * Record:
+ *
+ *   | SEQUENCE | EVENT | USER ID (2 bytes) | TIME (3 bytes) | CRC-8 |
+ *
+ * Multi-byte fields are LSB first. TIME is in seconds since the last
+ * AUDIT_BOOT record, SEQUENCE is an 8-bit counter (compared modulo 256)
+ * used to find the end of the log at boot. The CRC covers every byte before it.
+ */
+#define AUDIT_RECORD_SIZE       8
+#define AUDIT_LOG_SLOTS         (EEPROM_AUDIT_LOG_SIZE / AUDIT_RECORD_SIZE)
+#define AUDIT_SEQUENCE_OFFSET   0
+#define AUDIT_EVENT_OFFSET      1
+#define AUDIT_USER_OFFSET       2
+#define AUDIT_TIME_OFFSET       4
+#define AUDIT_CRC_OFFSET        (AUDIT_RECORD_SIZE - 1)
+
+/* Records staged in RAM before they are written (power of two) */
+#define AUDIT_RING_SIZE         8
+
+/* A partly filled page is written once its oldest record waited this long */
+#define AUDIT_FLUSH_DELAY_MS    1000
+
+#if (AUDIT_LOG_SLOTS > 127) || ((EEPROM_PAGE_SIZE % AUDIT_RECORD_SIZE) != 0)
+#error "Audit log records must not cross a page and the sequence must tell the slots apart"
+#endif
+#if (AUDIT_RING_SIZE & (AUDIT_RING_SIZE - 1)) != 0
+#error "AUDIT_RING_SIZE must be a power of two"
+#endif
+
+/* Events */
+#define AUDIT_BOOT              0x01    /* Control ECU started */
+#define AUDIT_ACCESS_GRANTED    0x02    /* PASS_IN verified, door opened */
+#define AUDIT_ACCESS_DENIED     0x03    /* PASS_IN / PASS_UPDATE answered with PASS_FAIL */
+#define AUDIT_ALARM             0x04    /* ALARM_ON after repeated failures */
+#define AUDIT_PASS_CHANGED      0x05    /* Admin password loaded or changed */
+#define AUDIT_USER_ADDED        0x06    /* USER_ADD accepted */
+#define AUDIT_DOOR_CLOSED       0x07    /* Door cycle finished */
+#define AUDIT_ADMIN_VERIFIED    0x08    /* PASS_UPDATE verified */
+#define AUDIT_DOOR_BUSY         0x09    /* PASS_IN verified while the door was cycling, not opened */
+#define AUDIT_DROPPED           0x0A    /* Events lost before this one, the count is in the user ID field */
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Find the end of the log with one pass over the EEPROM region.
+ * Called once at boot, before any AuditLog_record.
+ */
+void AuditLog_init(void);
+
+/*
+ * Description :
+ * Stage an event in the RAM ring. Nothing waits for the EEPROM: a completed
+ * page is handed to the TWI engine in the background. If the ring is full
+ * the event is counted as dropped.
+ */
+void AuditLog_record(uint8 event, uint16 user);
+
+/*
+ * Description :
+ * Write staged records: complete pages right away, a partial page once it
+ * is AUDIT_FLUSH_DELAY_MS old. A failed page write is retried, then its
+ * records are counted as dropped. Once the ring has room again the dropped
+ * count is taken and logged as an AUDIT_DROPPED record. Called from the idle loop.
+ */
+void AuditLog_service(void);
+
+/*
+ * Description :
+ * Write every staged record and wait until they are in the EEPROM.
+ */
+void AuditLog_flush(void);
+
+/*
+ * Description :
+ * Non blocking read of count records starting at index, in recording order
+ * (index 0 is the oldest slot of the log). The read stops at the end of the
+ * EEPROM region so it stays one sequential transaction.
+ * Returns the number of records queued, 0 if none (index past the log or TWI queue full).
+ */
+uint8 AuditLog_submitRead(TWI_TransactionType *transaction, uint16 index, uint8 *buffer, uint8 count);
+
+/*
+ * Description :
+ * Return the number of events lost because the ring was full or their page
+ * could not be written, and clear it.
+ */
+uint8 AuditLog_takeDropped(void);
+
+#endif /* AUDITLOG_H_ */
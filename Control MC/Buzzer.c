@@ -1,6 +1,10 @@
 #include "Buzzer.h"
 #include "GPIO.h"
 
+/* Timer.h selects the Timer1 prescaler and TOP for this period */
+#define TIMER1_PERIOD_US	BUZZER_BEEP_PERIOD_US
+#include "Timer.h"
+
 void Buzzer_init(void){
 	GPIO_setupPinDirection(BUZZER_PORT_ID, BUZZER_PIN_ID, PIN_OUTPUT);
 	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_LOW);
@@ -10,6 +14,26 @@ void Buzzer_on(void){
 	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_HIGH);
 }
 
+/* Compare A ends a period (CTC TOP), compare B falls in its middle */
+static void Buzzer_periodStart(void){
+	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_HIGH);
+}
+
+static void Buzzer_halfPeriod(void){
+	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_LOW);
+}
+
+void Buzzer_beep(void){
+	Timer1_ConfigType timer1_cfg = { TIMER1_CTC_MODE, TIMER1_CLOCK, TIMER1_TOP_VALUE,
+			0, TIMER1_US_TO_COUNTS(BUZZER_BEEP_PERIOD_US / 2), TIMER1_RISING_EDGE };
+
+	Timer1_init(&timer1_cfg);
+	Timer1_setCallBack(Buzzer_periodStart, TIMER1_EVENT_COMPARE_A);
+	Timer1_setCallBack(Buzzer_halfPeriod, TIMER1_EVENT_COMPARE_B);
+	Buzzer_periodStart();
+}
+
 void Buzzer_off(void){
+	Timer_deInit(TIMER1_ID);
 	GPIO_writePin(BUZZER_PORT_ID, BUZZER_PIN_ID, LOGIC_LOW);
 }
@@ -6,10 +6,16 @@
 #define BUZZER_PORT_ID 	PORTC_ID
 #define BUZZER_PIN_ID 	PIN7_ID
 
+/* Alarm beep: on for half of each period, timed by Timer1 compare A/B */
+#define BUZZER_BEEP_PERIOD_US	500000UL
+
 void Buzzer_init(void);
 
 void Buzzer_on(void);
 
+/* Beep in the background until Buzzer_off, Timer1 is used meanwhile */
+void Buzzer_beep(void);
+
 void Buzzer_off(void);
 
 
@@ -1,36 +1,222 @@
 #include "UART.h"
+#include "Link.h"
 #include "I2C.h"
 #include "EEPROM.h"
+#include "Credential.h"
+#include "UserTable.h"
+#include "AuditLog.h"
+#include "Hash.h"
+#include "Settings.h"
 #include "Motor.h"
 #include "Buzzer.h"
 #include "PIR_Sensor.h"
 #include "Timer.h"
+#include "SoftTimer.h"
+#include "Event.h"
+#include "Power.h"
+#include "ADC.h"
 #include "std_types.h"
 #include <avr/io.h>
-#include <util/delay.h>
 #include <string.h>
 
-#define PASS_LOAD        0xA0    // Command: Load new password
-#define PASS_IN          0xF1    // Command: Verify existing password
-#define PASS_UPDATE      0xE0    // Command: Update existing password
-#define PASS_CORRECT     0xC0    // Response: Password verified successfully
-#define PASS_FAIL        0xF0    // Response: Password verification failed
-#define PEOPLE_IN        0xB0    // Response: People detected entering
-#define PEOPLE_NO        0xD0    // Response: No people detected
-#define ALARM_ON         0xF2    // Command: Activate alarm
-#define START_ADDRESS    0x000   // Starting EEPROM address for password storage
-#define DOOR_CLOSED      0xF3    // Response: Door closed
-
-uint8 timerCount = 0;
-uint8 progState = 0;
-boolean status = FALSE;
-boolean peopleIN = FALSE;
+#define IDLE_TIMEOUT_MS      500     // Parser and sequence resync period while no command arrives
+#define UPDATE_WINDOW_MS     30000   // PASS_NEW / USER_ADD / CONFIG_SET must follow a verified PASS_UPDATE within this time
+#define PEOPLE_KEEPALIVE_MS  1000    // PEOPLE_IN is repeated while people keep entering
+#define PIR_SETTLE_MS        500     // First PIR sample once the door is open
+#define PIR_SAMPLE_MS        20      // PIR sampling period while the door is held open
+
+#if IDLE_TIMEOUT_MS <= LINK_RETRY_SPAN_MS
+#error "IDLE_TIMEOUT_MS must exceed LINK_RETRY_SPAN_MS, Link_resync forgets the last received sequence"
+#endif
+
+// Audit log records per LOG_DATA frame, and per EEPROM read while dumping
+#define LOG_FRAME_RECORDS    ((FRAME_MAX_PAYLOAD - LOG_OFFSET_LENGTH) / AUDIT_RECORD_SIZE)
+#define LOG_CHUNK_RECORDS    (2 * LOG_FRAME_RECORDS)
+
+/*
+ * Events posted by the soft timer callbacks (tick interrupt) or by the
+ * command handlers, each one is routed to its task by eventTasks.
+ */
+typedef enum {
+    EVENT_DOOR_OPEN,      // Access granted
+    EVENT_DOOR_TIMER,     // Door motor run time elapsed
+    EVENT_PIR_CLEAR,      // Nobody in front of the PIR any more
+    EVENT_KEEPALIVE,      // PEOPLE_IN period while the door is held open
+    EVENT_ALARM_START,    // ALARM_ON received
+    EVENT_ALARM_TIMER,    // Lockout time elapsed
+    EVENT_UPDATE_TIMER,   // Update window elapsed
+    EVENT_LINK_IDLE,      // No command for IDLE_TIMEOUT_MS
+    EVENT_COUNT
+} Control_EventType;
+
+// Task states, reported as is by STATUS_DATA
+typedef enum {
+    DOOR_IDLE = STATUS_DOOR_IDLE,
+    DOOR_OPENING = STATUS_DOOR_OPENING,
+    DOOR_HOLDING = STATUS_DOOR_HOLDING,
+    DOOR_CLOSING = STATUS_DOOR_CLOSING
+} Door_StateType;
+
+typedef enum {
+    ALARM_SILENT = STATUS_ALARM_SILENT,
+    ALARM_SOUNDING = STATUS_ALARM_SOUNDING
+} Alarm_StateType;
+
+typedef enum {
+    ACCESS_IDLE = STATUS_ACCESS_IDLE,
+    ACCESS_VERIFYING = STATUS_ACCESS_VERIFYING,
+    ACCESS_UPDATE = STATUS_ACCESS_UPDATE
+} Access_StateType;
+
+typedef struct {
+    uint8 type;
+    void (*handler)(const Frame_Type *frame);
+} Command_EntryType;
+
+Door_StateType doorState = DOOR_IDLE;
+Alarm_StateType alarmState = ALARM_SILENT;
+Access_StateType accessState = ACCESS_IDLE;
+uint16 doorUser = USER_ID_ADMIN;  // User the current door cycle was opened for
+SoftTimer_Type updateTimer;     // Closes the update window
+SoftTimer_Type doorTimer;       // Door motor run time
+SoftTimer_Type pirTimer;        // Samples the PIR while the door is held open
+SoftTimer_Type keepaliveTimer;  // Paces PEOPLE_IN while the door is held open
+SoftTimer_Type alarmTimer;      // Silences the buzzer after the lockout time
+SoftTimer_Type linkTimer;       // Restarted by every command, expires while the link is idle
 uint8 password[10] = { 0 };
 uint8 i = 0;
+Frame_Type rxFrame;
 
-void Timer_Callback(void);
+// LOG_DUMP double buffer: one chunk is read from the EEPROM while the other is sent
+uint8 logChunk[2][LOG_CHUNK_RECORDS * AUDIT_RECORD_SIZE];
+TWI_TransactionType logRead[2];
+
+// Streamed password verification in progress (ACCESS_VERIFYING): PASS_IN or PASS_UPDATE
+uint8 verifyCommand = 0;
+// User being verified, the digits of other users than the admin are hashed at the end
+uint16 verifyUser = USER_ID_ADMIN;
+uint8 verifyDigits[PASS_LENGTH];
+uint8 verifyCount = 0;
+
+void Begin_Verify(uint8 command, const uint8 *user);
+
+void Verify_Digit(uint8 digit);
+
+boolean Verify_Result(void);
+
+void Finish_Verify(void);
+
+void Close_Update(void);
+
+void Dump_Log(uint16 offset);
+
+void Door_Task(uint8 event);
+
+void Alarm_Task(uint8 event);
+
+void Access_Task(uint8 event);
+
+void Idle_Task(uint8 event);
+
+void Handle_PassStore(const Frame_Type *frame);
+
+void Handle_UserAdd(const Frame_Type *frame);
+
+void Handle_Verify(const Frame_Type *frame);
+
+void Handle_Digit(const Frame_Type *frame);
+
+void Handle_End(const Frame_Type *frame);
+
+void Handle_Provisioned(const Frame_Type *frame);
+
+void Handle_BaudCaps(const Frame_Type *frame);
+
+void Handle_LogDump(const Frame_Type *frame);
+
+void Handle_ConfigGet(const Frame_Type *frame);
+
+void Handle_ConfigSet(const Frame_Type *frame);
+
+void Handle_StatusGet(const Frame_Type *frame);
+
+void Handle_Alarm(const Frame_Type *frame);
+
+#ifdef POWER_STATS
+void Handle_PowerGet(const Frame_Type *frame);
+#endif
+
+// Opcode dispatch, searched linearly (a handful of compares)
+const Command_EntryType commands[] = {
+    { PASS_LOAD,         Handle_PassStore },
+    { PASS_NEW,          Handle_PassStore },
+    { USER_ADD,          Handle_UserAdd },
+    { PASS_IN,           Handle_Verify },
+    { PASS_UPDATE,       Handle_Verify },
+    { PASS_DIGIT,        Handle_Digit },
+    { PASS_END,          Handle_End },
+    { QUERY_PROVISIONED, Handle_Provisioned },
+    { BAUD_CAPS,         Handle_BaudCaps },
+    { LOG_DUMP,          Handle_LogDump },
+    { CONFIG_GET,        Handle_ConfigGet },
+    { CONFIG_SET,        Handle_ConfigSet },
+    { STATUS_GET,        Handle_StatusGet },
+    { ALARM_ON,          Handle_Alarm },
+#ifdef POWER_STATS
+    { POWER_GET,         Handle_PowerGet },
+#endif
+};
+
+// Task receiving each Control_EventType
+void (*const eventTasks[EVENT_COUNT])(uint8 event) = {
+    Door_Task,    // EVENT_DOOR_OPEN
+    Door_Task,    // EVENT_DOOR_TIMER
+    Door_Task,    // EVENT_PIR_CLEAR
+    Door_Task,    // EVENT_KEEPALIVE
+    Alarm_Task,   // EVENT_ALARM_START
+    Alarm_Task,   // EVENT_ALARM_TIMER
+    Access_Task,  // EVENT_UPDATE_TIMER
+    Idle_Task     // EVENT_LINK_IDLE
+};
+
+/*
+ * Soft timer callbacks, run from the tick interrupt: only post events.
+ */
+void Post_DoorTimer(void) {
+    Event_post(EVENT_DOOR_TIMER);
+}
+
+void Post_Keepalive(void) {
+    Event_post(EVENT_KEEPALIVE);
+}
+
+void Post_AlarmTimer(void) {
+    Event_post(EVENT_ALARM_TIMER);
+}
+
+void Post_UpdateTimer(void) {
+    Event_post(EVENT_UPDATE_TIMER);
+}
+
+void Post_LinkIdle(void) {
+    Event_post(EVENT_LINK_IDLE);
+}
+
+void Sample_Pir(void) {
+    if (!PIR_getState()) {
+        Event_post(EVENT_PIR_CLEAR);
+    }
+}
+
+// Sleep condition of the main loop, checked with the interrupts off
+boolean Work_isPending(void) {
+    return Event_isPending() || UART_isRxPending();
+}
 
 int main() {
+    uint8 event;
+    uint8 entry;
+    uint32 arrival;
 
     // UART Configuration and Initialization
     UART_ConfigType uart_cfg = { UART_8_BIT,
@@ -38,170 +224,488 @@ int main() {
             UART_1_STOP_BIT,
 			9600 };
     UART_init(&uart_cfg);
+    Link_init();
 
     // Buzzer Initialization
     Buzzer_init();
 
-    // I2C Configuration and Initialization
-    TWI_ConfigType i2c_cfg = { 0x01,
-    		2,
-			TWI_PRE_1 };
+    // 1 ms system tick for all the timeouts, the soft timers post their events.
+    // Started before the EEPROM users: the TWI transaction watchdog counts ticks
+    Event_init();
+    SREG |= (1<<7);  // Enable global interrupts
+    Timer_startTick();
+    SoftTimer_init();
+
+    // I2C Configuration and Initialization, SCL is set by TWI_SCL_FREQ (400 kHz)
+    TWI_ConfigType i2c_cfg = { 0x01 };
     TWI_init(&i2c_cfg);
 
+    // Seed the salt generator before anything can draw a salt: the low bits of
+    // the bandgap reference read by the ADC are noise (about 13 ms)
+    ADC_init();
+    while (!Hash_isSeeded()) {
+        Hash_addEntropy((uint8)ADC_readChannel(ADC_BANDGAP_CHANNEL));
+    }
+    ADC_deInit();
+
+    // Load the stored password once, all checks are served from RAM
+    Credential_init();
+
+    // Index the user table, a user PIN check then costs a single EEPROM read
+    UserTable_init();
+
+    // Door and lockout timings, tunable with CONFIG_SET
+    Settings_init();
+
+    // Find the end of the audit log, events are staged in RAM and written a page at a time
+    AuditLog_init();
+
     // Motor Initialization
     DcMotor_Init();
 
     // PIR Sensor Initialization
     PIR_init();
 
-    // Timer1 Configuration and Initialization for timeout tracking
-    SREG |= (1<<7);  // Enable global interrupts
-    Timer_ConfigType timer1 = { 0,
-    		31250,
-			TIMER1_ID,
-			TIMER_PRESCALE_256,
-            TIMER_COMPARE_MODE };
-    Timer_init(&timer1);
-    Timer_setCallBack(Timer_Callback, TIMER1_ID);
+    SoftTimer_start(&linkTimer, IDLE_TIMEOUT_MS, IDLE_TIMEOUT_MS, Post_LinkIdle);
+    AuditLog_record(AUDIT_BOOT, USER_ID_ADMIN);
 
 
+    // Nothing below blocks for long: the door and alarm run as state machines
+    // stepped by timer events, so a command is served at any time
     while(1) {
-        // Listen for program command from UART
-        progState = UART_receiveByte();
-
-        // Handling password creation and verification process
-        if (progState == PASS_LOAD) {
-
-            // Receive new password (10 bytes: 5 for password and 5 for confirmation)
-            for (i = 0; i < 10; ++i) {
-                password[i] = UART_receiveByte();
+        // Events first, a command never sees a window or timer that already expired
+        if (Event_get(&event)) {
+            if (event < EVENT_COUNT) {
+                eventTasks[event](event);
             }
+        }
+        else if (Link_poll(&rxFrame)) {
+            SoftTimer_start(&linkTimer, IDLE_TIMEOUT_MS, IDLE_TIMEOUT_MS, Post_LinkIdle);
+
+            // Frames follow key presses, their arrival time keeps stirring the pool
+            arrival = Timer_getMicros();
+            Hash_addEntropy((uint8)arrival ^ (uint8)(arrival >> 8));
 
-            // Verify if the new password matches the confirmation input
-            for (i = 0; i < 5; ++i) {
-                if (password[i] != password[i + 5]) {
-                    // Notify HMI of mismatch in password confirmation
-                    UART_sendByte(PASS_FAIL);
+            for (entry = 0; entry < (sizeof(commands) / sizeof(commands[0])); ++entry) {
+                if (commands[entry].type == rxFrame.type) {
+                    commands[entry].handler(&rxFrame);
                     break;
                 }
             }
+        }
+        else {
+            // Abort a background EEPROM write stuck on a hung bus
+            TWI_checkTimeout();
+            // Write the audit events still waiting in RAM
+            AuditLog_service();
+            // Sleep unless an ISR queued work since the checks above,
+            // the next byte, event or tick wakes the CPU up
+            Power_idleUnless(Work_isPending);
+        }
+    }
+}
 
-            if (i == 5) {  // Password successfully matched
-                UART_sendByte(PASS_CORRECT);  // Notify HMI of successful match
-
-                // Save new password to EEPROM
-                for (i = 0; i < 5; ++i) {
-                    status = EEPROM_writeByte(START_ADDRESS + i, password[i]);
-                    _delay_ms(10); // Delay for EEPROM write
-                }
-            }
+/*
+ * Door task: open, hold while the PIR sees people, close.
+ */
+void Door_Task(uint8 event) {
+    switch (doorState) {
+    case DOOR_IDLE:
+        if (event == EVENT_DOOR_OPEN) {
+            // Open door (15 seconds by default)
+            DcMotor_Rotate(CW, 100);
+            SoftTimer_start(&doorTimer, (uint32)Settings_get()->door_seconds * 1000, 0, Post_DoorTimer);
+            doorState = DOOR_OPENING;
+        }
+        break;
+    case DOOR_OPENING:
+        if (event == EVENT_DOOR_TIMER) {
+            // Stop the motor (door open)
+            DcMotor_Rotate(STOP, 0);
+
+            // Check for any further people entering, PEOPLE_IN is repeated
+            // as a keep-alive so the HMI can tell a long wait from a lost link
+            Link_send(PEOPLE_IN, NULL_PTR, 0);
+            SoftTimer_start(&keepaliveTimer, PEOPLE_KEEPALIVE_MS, PEOPLE_KEEPALIVE_MS, Post_Keepalive);
+            SoftTimer_start(&pirTimer, PIR_SETTLE_MS, PIR_SAMPLE_MS, Sample_Pir);
+            doorState = DOOR_HOLDING;
+        }
+        break;
+    case DOOR_HOLDING:
+        if (event == EVENT_KEEPALIVE) {
+            Link_send(PEOPLE_IN, NULL_PTR, 0);
+        }
+        else if (event == EVENT_PIR_CLEAR) {
+            // Begin door closure sequence
+            SoftTimer_stop(&keepaliveTimer);
+            SoftTimer_stop(&pirTimer);
+            Link_send(PEOPLE_NO, NULL_PTR, 0);
+            DcMotor_Rotate(A_CW, 100);
+            SoftTimer_start(&doorTimer, (uint32)Settings_get()->door_seconds * 1000, 0, Post_DoorTimer);
+            doorState = DOOR_CLOSING;
+        }
+        break;
+    case DOOR_CLOSING:
+        if (event == EVENT_DOOR_TIMER) {
+            DcMotor_Rotate(STOP, 0);
+            Link_send(DOOR_CLOSED, NULL_PTR, 0);
+            AuditLog_record(AUDIT_DOOR_CLOSED, doorUser);
+            doorState = DOOR_IDLE;
         }
-        else if (progState == PASS_IN) {
-            // Receive and validate user-entered password
+        break;
+    }
+}
 
-            for (i = 0; i < 5; ++i) {
-                password[i] = UART_receiveByte();
-            }
+/*
+ * Alarm task: beep the buzzer for the lockout time, a new ALARM_ON restarts it.
+ */
+void Alarm_Task(uint8 event) {
+    if (event == EVENT_ALARM_START) {
+        Buzzer_beep();
+        SoftTimer_start(&alarmTimer, (uint32)Settings_get()->lockout_seconds * 1000, 0, Post_AlarmTimer);
+        alarmState = ALARM_SOUNDING;
+    }
+    else if ((event == EVENT_ALARM_TIMER) && (alarmState == ALARM_SOUNDING)) {
+        Buzzer_off();
+        alarmState = ALARM_SILENT;
+    }
+}
 
-            // Retrieve stored password from EEPROM for comparison
-            for (i = 5; i < 10; ++i) {
-                status = EEPROM_readByte(START_ADDRESS + i - 5, &password[i]);
-                _delay_ms(10); // Delay for EEPROM read
-            }
+/*
+ * Credential task: the update window opened by a verified PASS_UPDATE times out.
+ * The verification itself is stepped by the PASS_* command handlers.
+ */
+void Access_Task(uint8 event) {
+    if ((event == EVENT_UPDATE_TIMER) && (accessState == ACCESS_UPDATE)) {
+        accessState = ACCESS_IDLE;
+    }
+}
 
-            // Compare entered password with stored password
-            for (i = 0; i < 5; ++i) {
-                if (password[i] != password[i + 5]) {
-                    UART_sendByte(PASS_FAIL);  // Notify HMI of failure
-                    break;
-                }
-            }
+/*
+ * No command for IDLE_TIMEOUT_MS: drop any partial frame and restart the sequences.
+ */
+void Idle_Task(uint8 event) {
+    // Line errors without any valid frame mean the HMI restarted
+    // and is talking at 9600 baud again
+    if (Link_takeErrors() != 0) {
+        UART_setRate(UART_RATE_9600);
+    }
+    Link_resync();
+}
 
-            if (i == 5) {
-                UART_sendByte(PASS_CORRECT);  // Password verification success
-
-                // Open door for 15 seconds
-                DcMotor_Rotate(CW, 100);
-                timerCount = 0;
-                while (timerCount < 5);
-
-                // Stop the motor (door closed)
-                DcMotor_Rotate(STOP, 0);
-
-                // Check for any further people entering
-                UART_sendByte(PEOPLE_IN);
-                _delay_ms(500);
-                do {
-                    peopleIN = PIR_getState();
-                } while (peopleIN);
-
-                // Begin door closure sequence
-                UART_sendByte(PEOPLE_NO);
-                timerCount = 0;
-                DcMotor_Rotate(A_CW, 100);
-                while (timerCount < 5);
-                DcMotor_Rotate(STOP, 0);
-                UART_sendByte(DOOR_CLOSED);
-            }
+/*
+ * Close the update window, PASS_NEW / USER_ADD / CONFIG_SET are refused again.
+ */
+void Close_Update(void) {
+    if (accessState == ACCESS_UPDATE) {
+        SoftTimer_stop(&updateTimer);
+        accessState = ACCESS_IDLE;
+    }
+}
+
+/*
+ * PASS_LOAD / PASS_NEW: store a new admin password.
+ */
+void Handle_PassStore(const Frame_Type *frame) {
+    // A new password is only accepted after a successful PASS_UPDATE,
+    // or when loading the password for the first time
+    if (((frame->type == PASS_NEW) && (accessState != ACCESS_UPDATE)) ||
+        ((frame->type == PASS_LOAD) && Credential_isProvisioned())) {
+        Link_send(PASS_FAIL, NULL_PTR, 0);
+        return;
+    }
+    Close_Update();
+
+    // Frame holds the new password (5 bytes) followed by its confirmation (5 bytes)
+    if (frame->length != PASS_PAIR_LENGTH) {
+        Link_send(PASS_FAIL, NULL_PTR, 0);
+        return;
+    }
+    memcpy(password, frame->payload, PASS_PAIR_LENGTH);
+
+    // Verify if the new password matches the confirmation input (constant time)
+    if (!Hash_equal(password, &password[PASS_LENGTH], PASS_LENGTH)) {
+        // Notify HMI of mismatch in password confirmation
+        Link_send(PASS_FAIL, NULL_PTR, 0);
+    }
+    // Password successfully matched, save it (single page write) and only
+    // report success once it is in the EEPROM
+    else if (Credential_store(password) == SUCCESS) {
+        Link_send(PASS_CORRECT, NULL_PTR, 0);  // Notify HMI of successful match
+        AuditLog_record(AUDIT_PASS_CHANGED, USER_ID_ADMIN);
+    }
+    else {
+        Link_send(PASS_FAIL, NULL_PTR, 0);  // EEPROM write failed, the old password stays
+    }
+    memset(password, 0, sizeof(password));  // Only the salted digest is kept
+}
+
+/*
+ * USER_ADD: user ID followed by the PIN and its confirmation, admin verified first.
+ */
+void Handle_UserAdd(const Frame_Type *frame) {
+    uint16 user = (uint16)frame->payload[0] | ((uint16)frame->payload[1] << 8);
+
+    if ((accessState != ACCESS_UPDATE) || (frame->length != USER_ID_LENGTH + PASS_PAIR_LENGTH) ||
+        !Hash_equal(&frame->payload[USER_ID_LENGTH], &frame->payload[USER_ID_LENGTH + PASS_LENGTH], PASS_LENGTH)) {
+        Link_send(PASS_FAIL, NULL_PTR, 0);
+    }
+    else if (UserTable_add(user, &frame->payload[USER_ID_LENGTH]) == SUCCESS) {
+        Link_send(PASS_CORRECT, NULL_PTR, 0);
+        AuditLog_record(AUDIT_USER_ADDED, user);
+    }
+    else {
+        Link_send(PASS_FAIL, NULL_PTR, 0);  // Table full
+    }
+    Close_Update();
+}
+
+/*
+ * PASS_IN / PASS_UPDATE: a frame without the password opens a streamed verification,
+ * the HMI sends it on the first key press and the digits follow as they are typed.
+ * The user ID is optional, without it the admin password is checked.
+ */
+void Handle_Verify(const Frame_Type *frame) {
+    uint8 offset;
+
+    Close_Update();
+    if ((frame->length == 0) || (frame->length == USER_ID_LENGTH)) {
+        Begin_Verify(frame->type, (frame->length == 0) ? NULL_PTR : frame->payload);
+    }
+    else if ((frame->length == PASS_LENGTH) || (frame->length == USER_ID_LENGTH + PASS_LENGTH)) {
+        // Whole password in one frame
+        offset = frame->length - PASS_LENGTH;
+        Begin_Verify(frame->type, (offset == 0) ? NULL_PTR : frame->payload);
+        for (i = 0; i < PASS_LENGTH; ++i) {
+            Verify_Digit(frame->payload[offset + i]);
         }
-        else if (progState == PASS_UPDATE) {
-            // Handle password update
+        Finish_Verify();
+    }
+    else {
+        Link_send(PASS_FAIL, NULL_PTR, 0);
+    }
+}
 
-            for (i = 0; i < 5; ++i) {
-                password[i] = UART_receiveByte();
-            }
+void Handle_Digit(const Frame_Type *frame) {
+    if (frame->length == 1) {
+        Verify_Digit(frame->payload[0]);
+    }
+}
 
-            // Retrieve stored password for verification
-            for (i = 5; i < 10; ++i) {
-                status = EEPROM_readByte(START_ADDRESS + i - 5, &password[i]);
-                _delay_ms(10);
-            }
+void Handle_End(const Frame_Type *frame) {
+    Finish_Verify();
+}
 
-            // Verify current password before updating
-            for (i = 0; i < 5; ++i) {
-                if (password[i] != password[i + 5]) {
-                    UART_sendByte(PASS_FAIL);  // Current password mismatch
-                    break;
-                }
-            }
+/*
+ * QUERY_PROVISIONED: HMI boot, answered from the credential log validated once by Credential_init.
+ */
+void Handle_Provisioned(const Frame_Type *frame) {
+    uint8 flags = Credential_isProvisioned() ? PROVISIONED_PASSWORD : 0;
+    Link_send(PROVISIONED_STATE, &flags, 1);
+}
 
-            if (i == 5) {  // Password verified for update
-                UART_sendByte(PASS_CORRECT);
+/*
+ * BAUD_CAPS: HMI (re)started, agree on the fastest common baud rate.
+ */
+void Handle_BaudCaps(const Frame_Type *frame) {
+    Close_Update();
+    Link_acceptRate(frame);
+}
 
-                // Receive new password
-                for (i = 0; i < 10; ++i) {
-                    password[i] = UART_receiveByte();
-                }
+/*
+ * LOG_DUMP: export the audit log, the host resumes from the last offset it received.
+ */
+void Handle_LogDump(const Frame_Type *frame) {
+    if (frame->length == LOG_OFFSET_LENGTH) {
+        Dump_Log((uint16)frame->payload[0] | ((uint16)frame->payload[1] << 8));
+    }
+}
 
-                // Verify new password confirmation
-                for (i = 0; i < 5; ++i) {
-                    if (password[i] != password[i + 5]) {
-                        UART_sendByte(PASS_FAIL);
-                        break;
-                    }
-                }
+void Handle_ConfigGet(const Frame_Type *frame) {
+    uint8 settings[CONFIG_PAYLOAD_LENGTH];
+    Settings_encode(settings);
+    Link_send(CONFIG_DATA, settings, CONFIG_PAYLOAD_LENGTH);
+}
 
-                if (i == 5) {  // New password confirmed
-                    UART_sendByte(PASS_CORRECT);
+/*
+ * CONFIG_SET: admin verified first, like PASS_NEW.
+ */
+void Handle_ConfigSet(const Frame_Type *frame) {
+    if ((accessState == ACCESS_UPDATE) && (frame->length == CONFIG_PAYLOAD_LENGTH) &&
+        (Settings_set(frame->payload) == SUCCESS)) {
+        Link_send(PASS_CORRECT, NULL_PTR, 0);
+    }
+    else {
+        Link_send(PASS_FAIL, NULL_PTR, 0);
+    }
+    Close_Update();
+}
 
-                    // Save new password to EEPROM
-                    for (i = 0; i < 5; ++i) {
-                        status = EEPROM_writeByte(START_ADDRESS + i, password[i]);
-                        _delay_ms(10);
-                    }
-                }
-            }
+/*
+ * STATUS_GET: state of the door, alarm and credential tasks.
+ */
+void Handle_StatusGet(const Frame_Type *frame) {
+    uint8 payload[STATUS_PAYLOAD_LENGTH];
+
+    payload[STATUS_DOOR_OFFSET] = (uint8)doorState;
+    payload[STATUS_ALARM_OFFSET] = (uint8)alarmState;
+    payload[STATUS_ACCESS_OFFSET] = (uint8)accessState;
+    Link_send(STATUS_DATA, payload, STATUS_PAYLOAD_LENGTH);
+}
+
+/*
+ * ALARM_ON: activate the alarm for the lockout time.
+ */
+void Handle_Alarm(const Frame_Type *frame) {
+    Close_Update();
+    AuditLog_record(AUDIT_ALARM, USER_ID_ADMIN);
+    Alarm_Task(EVENT_ALARM_START);
+}
+
+#ifdef POWER_STATS
+/*
+ * POWER_GET: active vs sleep time since the previous POWER_GET.
+ */
+void Handle_PowerGet(const Frame_Type *frame) {
+    Power_StatsType stats;
+    uint8 payload[POWER_PAYLOAD_LENGTH];
+
+    Power_takeStats(&stats);
+    for (i = 0; i < 4; ++i) {
+        payload[POWER_SLEEP_OFFSET + i] = (uint8)(stats.sleep_us >> (8 * i));
+        payload[POWER_WINDOW_OFFSET + i] = (uint8)(stats.window_us >> (8 * i));
+    }
+    Link_send(POWER_DATA, payload, POWER_PAYLOAD_LENGTH);
+}
+#endif
+
+/*
+ * Start a verification of user (USER_ID_LENGTH bytes, NULL_PTR for the admin).
+ * The admin password is already cached in RAM.
+ */
+void Begin_Verify(uint8 command, const uint8 *user) {
+    verifyCommand = command;
+    accessState = ACCESS_VERIFYING;
+    verifyUser = (user == NULL_PTR) ? USER_ID_ADMIN : ((uint16)user[0] | ((uint16)user[1] << 8));
+    verifyCount = 0;
+    Credential_beginVerify();
+}
+
+/*
+ * Take one more entered digit: compared on arrival for the admin,
+ * buffered for the user table lookup otherwise.
+ * The result is only reported by Finish_Verify.
+ */
+void Verify_Digit(uint8 digit) {
+    if (accessState != ACCESS_VERIFYING) {
+        return;
+    }
+    if (verifyUser == USER_ID_ADMIN) {
+        Credential_verifyDigit(digit);
+    }
+    else {
+        if (verifyCount < PASS_LENGTH) {
+            verifyDigits[verifyCount] = digit;
         }
-        else if (progState == ALARM_ON) {
-            // Activate alarm for a duration of 60 seconds
-            Buzzer_on();
-            timerCount = 0;
-            while (timerCount < 20);
-            Buzzer_off();
+        if (verifyCount != 0xFF) {
+            verifyCount++;
         }
     }
 }
 
-void Timer_Callback(void) {
-    ++timerCount;
+/*
+ * Return TRUE if the digits received since Begin_Verify are the user's password.
+ */
+boolean Verify_Result(void) {
+    if (verifyUser == USER_ID_ADMIN) {
+        return Credential_endVerify();
+    }
+    // Only the admin may change the password
+    return (verifyCommand == PASS_IN) && (verifyCount == PASS_LENGTH) &&
+            UserTable_verify(verifyUser, verifyDigits);
+}
+
+/*
+ * Report the verdict of the current verification and act on it.
+ */
+void Finish_Verify(void) {
+    uint8 command = verifyCommand;
+    boolean verified = (accessState == ACCESS_VERIFYING) && Verify_Result();
+
+    accessState = ACCESS_IDLE;
+    if (!verified) {
+        Link_send(PASS_FAIL, NULL_PTR, 0);  // Notify HMI of failure
+        AuditLog_record(AUDIT_ACCESS_DENIED, verifyUser);
+    }
+    else if (command == PASS_UPDATE) {
+        // Admin verified, the HMI follows with a PASS_NEW or USER_ADD frame
+        Link_send(PASS_CORRECT, NULL_PTR, 0);
+        AuditLog_record(AUDIT_ADMIN_VERIFIED, verifyUser);
+        accessState = ACCESS_UPDATE;
+        SoftTimer_start(&updateTimer, UPDATE_WINDOW_MS, 0, Post_UpdateTimer);
+    }
+    else if (doorState != DOOR_IDLE) {
+        // Right password, but the door is still cycling for the previous entry:
+        // not a failed attempt, and not a grant either since it won't open
+        Link_send(DOOR_BUSY, NULL_PTR, 0);
+        AuditLog_record(AUDIT_DOOR_BUSY, verifyUser);
+    }
+    else {
+        Link_send(PASS_CORRECT, NULL_PTR, 0);  // Password verification success
+        AuditLog_record(AUDIT_ACCESS_GRANTED, verifyUser);
+        doorUser = verifyUser;
+        Door_Task(EVENT_DOOR_OPEN);
+    }
+}
+
+/*
+ * Stream the audit log from the record offset on as LOG_DATA frames, then LOG_END
+ * with the number of records sent. The next chunk is read from the EEPROM while the current one drains
+ * through the UART TX ring.
+ */
+void Dump_Log(uint16 offset) {
+    uint8 payload[LOG_OFFSET_LENGTH + LOG_FRAME_RECORDS * AUDIT_RECORD_SIZE];
+    uint8 queued[2];
+    uint8 current = 0;
+    uint8 sent;
+    uint8 count;
+    uint16 next;
+    uint16 start = offset;
+
+    // Records still staged in RAM are part of the dump
+    AuditLog_flush();
+
+    queued[0] = AuditLog_submitRead(&logRead[0], offset, logChunk[0], LOG_CHUNK_RECORDS);
+    next = offset + queued[0];
+    while (queued[current] != 0) {
+        queued[current ^ 1] = AuditLog_submitRead(&logRead[current ^ 1], next,
+                                                  logChunk[current ^ 1], LOG_CHUNK_RECORDS);
+        next += queued[current ^ 1];
+
+        if (!TWI_wait(&logRead[current])) {
+            break;  // The host asks again from the last offset it received
+        }
+        for (sent = 0; sent < queued[current]; sent += count) {
+            count = queued[current] - sent;
+            if (count > LOG_FRAME_RECORDS) {
+                count = LOG_FRAME_RECORDS;
+            }
+            payload[0] = (uint8)offset;
+            payload[1] = (uint8)(offset >> 8);
+            memcpy(&payload[LOG_OFFSET_LENGTH], &logChunk[current][sent * AUDIT_RECORD_SIZE],
+                   count * AUDIT_RECORD_SIZE);
+            Link_send(LOG_DATA, payload, LOG_OFFSET_LENGTH + count * AUDIT_RECORD_SIZE);
+            offset += count;
+        }
+        current ^= 1;
+    }
+
+    // The buffers are reused by the next dump
+    TWI_wait(&logRead[0]);
+    TWI_wait(&logRead[1]);
+
+    // Short of the end of the log if an EEPROM read failed, the host resumes from there
+    payload[0] = (uint8)(offset - start);
+    payload[1] = (uint8)((offset - start) >> 8);
+    Link_send(LOG_END, payload, LOG_OFFSET_LENGTH);
 }
@@ -0,0 +1,187 @@
+#include "Credential.h"
+#include "CRC.h"
+
+/* RAM copy of the newest record, only valid when g_provisioned is TRUE */
+static uint8 g_record[CREDENTIAL_RECORD_SIZE];
+static boolean g_provisioned = FALSE;
+
+/* Log slot and sequence number of g_record, the next update goes to the following slot */
+static uint8 g_slot = CREDENTIAL_LOG_SLOTS - 1;
+static uint16 g_sequence = 0xFFFF;
+
+/* Record being appended to the log, g_record only takes it once it is written */
+static uint8 g_writeRecord[CREDENTIAL_RECORD_SIZE];
+static TWI_TransactionType g_writeTransaction = { 0 };
+
+/* Incremental verification state */
+static uint8 g_verifyDigits[PASS_LENGTH];
+static uint8 g_verifyIndex = 0;
+
+static uint16 Credential_getSequence(const uint8 *record)
+{
+	return (uint16)record[CREDENTIAL_SEQUENCE_OFFSET] |
+			((uint16)record[CREDENTIAL_SEQUENCE_OFFSET + 1] << 8);
+}
+
+static boolean Credential_isValid(const uint8 *record)
+{
+	return (record[0] == CREDENTIAL_MAGIC) &&
+			(CRC8_compute(record, CREDENTIAL_CRC_OFFSET) == record[CREDENTIAL_CRC_OFFSET]);
+}
+
+/*
+ * Move the password stored in clear by the first firmware to the log, if any.
+ * The clear copy is only erased once a hashed record is in the log, a power
+ * loss in between finds it again at the next boot.
+ */
+static void Credential_migrateLegacy(void)
+{
+	uint8 legacy[PASS_LENGTH];
+	uint8 i;
+
+	if (EEPROM_readBlock(CREDENTIAL_LEGACY_ADDRESS, legacy, PASS_LENGTH) == ERROR)
+	{
+		return;
+	}
+	for (i = 0; i < PASS_LENGTH; ++i)
+	{
+		if (legacy[i] == 0xFF)
+		{
+			return;   /* Never written, or already erased */
+		}
+	}
+
+	/* A record already in the log is newer than the clear copy, keep it */
+	if (g_provisioned || (Credential_store(legacy) == SUCCESS))
+	{
+		for (i = 0; i < PASS_LENGTH; ++i)
+		{
+			legacy[i] = 0xFF;
+		}
+		EEPROM_writeBlock(CREDENTIAL_LEGACY_ADDRESS, legacy, PASS_LENGTH);
+	}
+}
+
+void Credential_init(void)
+{
+	uint8 record[CREDENTIAL_RECORD_SIZE];
+	uint8 slot;
+	uint8 i;
+	uint16 sequence;
+
+	g_provisioned = FALSE;
+	g_slot = CREDENTIAL_LOG_SLOTS - 1;
+	g_sequence = 0xFFFF;
+
+	/* One pass over the log, keep the valid record with the highest sequence number */
+	for (slot = 0; slot < CREDENTIAL_LOG_SLOTS; ++slot)
+	{
+		if (EEPROM_readBlock(EEPROM_CREDENTIAL_LOG_START + (uint16)slot * CREDENTIAL_RECORD_SIZE,
+				record, CREDENTIAL_RECORD_SIZE) == ERROR)
+		{
+			continue;
+		}
+		if (!Credential_isValid(record))
+		{
+			continue;   /* Erased slot or torn write */
+		}
+		sequence = Credential_getSequence(record);
+		if (g_provisioned && ((sint16)(sequence - g_sequence) <= 0))
+		{
+			continue;
+		}
+		for (i = 0; i < CREDENTIAL_RECORD_SIZE; ++i)
+		{
+			g_record[i] = record[i];
+		}
+		g_slot = slot;
+		g_sequence = sequence;
+		g_provisioned = TRUE;
+	}
+
+	Credential_migrateLegacy();
+}
+
+boolean Credential_isProvisioned(void)
+{
+	return g_provisioned;
+}
+
+uint8 Credential_store(const uint8 *password)
+{
+	uint8 i;
+	uint8 slot = (uint8)((g_slot + 1) % CREDENTIAL_LOG_SLOTS);
+	uint16 sequence = g_sequence + 1;
+
+	/* No salt before the pool is seeded, the previous credential stays */
+	if (!Hash_random(&g_writeRecord[CREDENTIAL_SALT_OFFSET], HASH_KEY_SIZE))
+	{
+		return ERROR;
+	}
+	g_writeRecord[0] = CREDENTIAL_MAGIC;
+	g_writeRecord[CREDENTIAL_SEQUENCE_OFFSET] = (uint8)sequence;
+	g_writeRecord[CREDENTIAL_SEQUENCE_OFFSET + 1] = (uint8)(sequence >> 8);
+	Hash_compute(&g_writeRecord[CREDENTIAL_SALT_OFFSET], password, PASS_LENGTH,
+			&g_writeRecord[CREDENTIAL_DIGEST_OFFSET]);
+	for (i = CREDENTIAL_DIGEST_OFFSET + HASH_DIGEST_SIZE; i < CREDENTIAL_CRC_OFFSET; ++i)
+	{
+		g_writeRecord[i] = 0xFF;
+	}
+	g_writeRecord[CREDENTIAL_CRC_OFFSET] = CRC8_compute(g_writeRecord, CREDENTIAL_CRC_OFFSET);
+
+	/* The record is exactly one page, one write on the TWI engine */
+	if (EEPROM_submitPageWrite(&g_writeTransaction,
+			EEPROM_CREDENTIAL_LOG_START + (uint16)slot * CREDENTIAL_RECORD_SIZE,
+			g_writeRecord, CREDENTIAL_RECORD_SIZE, NULL_PTR) != CREDENTIAL_RECORD_SIZE)
+	{
+		return ERROR;
+	}
+
+	/* Only a record that reached the EEPROM replaces the RAM copy, or a reset would bring the old one back */
+	if (!TWI_wait(&g_writeTransaction))
+	{
+		return ERROR;
+	}
+	for (i = 0; i < CREDENTIAL_RECORD_SIZE; ++i)
+	{
+		g_record[i] = g_writeRecord[i];
+	}
+	g_slot = slot;
+	g_sequence = sequence;
+	g_provisioned = TRUE;
+	return SUCCESS;
+}
+
+void Credential_beginVerify(void)
+{
+	g_verifyIndex = 0;
+}
+
+void Credential_verifyDigit(uint8 digit)
+{
+	if (g_verifyIndex < PASS_LENGTH)
+	{
+		g_verifyDigits[g_verifyIndex] = digit;
+	}
+	if (g_verifyIndex != 0xFF)
+	{
+		g_verifyIndex++;
+	}
+}
+
+boolean Credential_endVerify(void)
+{
+	uint8 digest[HASH_DIGEST_SIZE];
+	boolean match;
+	uint8 i;
+
+	/* The hash runs whatever the digit count, so a short entry takes as long as a full one */
+	Hash_compute(&g_record[CREDENTIAL_SALT_OFFSET], g_verifyDigits, PASS_LENGTH, digest);
+	match = Hash_equal(digest, &g_record[CREDENTIAL_DIGEST_OFFSET], HASH_DIGEST_SIZE);
+
+	for (i = 0; i < PASS_LENGTH; ++i)
+	{
+		g_verifyDigits[i] = 0;
+	}
+	return g_provisioned && (g_verifyIndex == PASS_LENGTH) && match;
+}
@@ -0,0 +1,84 @@
+#ifndef CREDENTIAL_H_
+#define CREDENTIAL_H_
+
+#include "std_types.h"
+#include "Frame.h"
+#include "EEPROM.h"
+#include "Hash.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * The credential is kept in a log of page sized records, each update is
+ * appended to the slot after the newest one (round-robin), so the writes are
+ * spread over the whole region and a power loss during an update only
+ * corrupts the new slot, the previous record stays valid.
+ *
+ * Record (one EEPROM page):
+ *   | MAGIC | SEQUENCE (2 bytes, LSB first) | SALT (8 bytes) | DIGEST (4 bytes) | CRC-8 |
+ * DIGEST is the HalfSipHash-2-4 of the password keyed with the record's
+ * random SALT, the password itself is never stored.
+ * The CRC covers every byte before it, the newest record has the highest
+ * sequence number (compared modulo 2^16).
+ */
+#define CREDENTIAL_MAGIC            0xC7
+#define CREDENTIAL_RECORD_SIZE      EEPROM_PAGE_SIZE
+#define CREDENTIAL_SEQUENCE_OFFSET  1
+#define CREDENTIAL_SALT_OFFSET      3
+#define CREDENTIAL_DIGEST_OFFSET    (CREDENTIAL_SALT_OFFSET + HASH_KEY_SIZE)
+#define CREDENTIAL_CRC_OFFSET       (CREDENTIAL_RECORD_SIZE - 1)
+#define CREDENTIAL_LOG_SLOTS        (EEPROM_CREDENTIAL_LOG_SIZE / CREDENTIAL_RECORD_SIZE)
+
+#if (CREDENTIAL_DIGEST_OFFSET + HASH_DIGEST_SIZE) > CREDENTIAL_CRC_OFFSET
+#error "The digest doesn't fit in a credential record"
+#endif
+
+/*
+ * The first firmware kept the password as PASS_LENGTH raw bytes at this
+ * address, no byte of a stored password is 0xFF (erased EEPROM).
+ * It is moved to the log hashed and erased at boot.
+ */
+#define CREDENTIAL_LEGACY_ADDRESS   EEPROM_CONFIG_START
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Scan the credential log once and load the newest valid record into RAM.
+ * Called once at boot, every later check is served from the RAM copy.
+ * A password left in clear by the first firmware is stored hashed and the
+ * clear copy erased.
+ */
+void Credential_init(void);
+
+/*
+ * Description :
+ * Return TRUE if a valid credential was loaded or stored.
+ */
+boolean Credential_isProvisioned(void);
+
+/*
+ * Description :
+ * Replace the credential: a new salt is drawn and the record appended to the
+ * log (one page write on the TWI engine, waited for). The RAM copy is only
+ * updated once the write completed.
+ * Returns SUCCESS if the record was written, ERROR (EEPROM.h) otherwise,
+ * the previous credential then stays in force.
+ */
+uint8 Credential_store(const uint8 *password);
+
+/*
+ * Description :
+ * Incremental verification: start, feed the entered digits one by one, then
+ * get the verdict. The digits are hashed with the stored salt and the digest
+ * compared in constant time.
+ */
+void Credential_beginVerify(void);
+void Credential_verifyDigit(uint8 digit);
+boolean Credential_endVerify(void);
+
+#endif /* CREDENTIAL_H_ */
@@ -1,71 +1,96 @@
 #include "EEPROM.h"
-#include "I2C.h"
 
-uint8 EEPROM_writeByte(uint16 u16addr, uint8 u8data)
+/*
+ * Fill a transaction addressing u16addr: A8 A9 A10 go in the device address,
+ * A0..A7 are sent as the sub address. ACK polling lets any transaction wait
+ * for the end of a previous write cycle on its own.
+ */
+static void EEPROM_setup(TWI_TransactionType *transaction, uint16 u16addr,
+		TWI_CallbackType callback)
 {
-	/* Send the Start Bit */
-    TWI_start();
-    if (TWI_getStatus() != TWI_START)
-        return ERROR;
+    transaction->address = (uint8)(0xA0 | ((u16addr & 0x0700)>>7));
+    transaction->flags = TWI_FLAG_SUB_ADDRESS | TWI_FLAG_ACK_POLL;
+    transaction->sub_address = (uint8)(u16addr);
+    transaction->write_buffer = NULL_PTR;
+    transaction->write_length = 0;
+    transaction->read_buffer = NULL_PTR;
+    transaction->read_length = 0;
+    transaction->callback = callback;
+}
 
-    /* Send the device address, we need to get A8 A9 A10 address bits from the
-     * memory location address and R/W=0 (write) */
-    TWI_writeByte((uint8)(0xA0 | ((u16addr & 0x0700)>>7)));
-    if (TWI_getStatus() != TWI_MT_SLA_W_ACK)
-        return ERROR;
+boolean EEPROM_submitRead(TWI_TransactionType *transaction, uint16 u16addr,
+		uint8 *data, uint16 len, TWI_CallbackType callback)
+{
+    EEPROM_setup(transaction, u16addr, callback);
+    transaction->read_buffer = data;
+    transaction->read_length = len;
 
-    /* Send the required memory location address */
-    TWI_writeByte((uint8)(u16addr));
-    if (TWI_getStatus() != TWI_MT_DATA_ACK)
-        return ERROR;
+    return TWI_submit(transaction);
+}
 
-    /* write byte to eeprom */
-    TWI_writeByte(u8data);
-    if (TWI_getStatus() != TWI_MT_DATA_ACK)
-        return ERROR;
+uint8 EEPROM_submitPageWrite(TWI_TransactionType *transaction, uint16 u16addr,
+		const uint8 *data, uint16 len, TWI_CallbackType callback)
+{
+    /* Bytes left in the page of u16addr */
+    uint8 chunk = EEPROM_PAGE_SIZE - (u16addr & (EEPROM_PAGE_SIZE - 1));
 
-    /* Send the Stop Bit */
-    TWI_stop();
+    if (chunk > len)
+        chunk = len;
 
-    return SUCCESS;
+    EEPROM_setup(transaction, u16addr, callback);
+    transaction->write_buffer = data;
+    transaction->write_length = chunk;
+
+    return TWI_submit(transaction) ? chunk : 0;
 }
 
-uint8 EEPROM_readByte(uint16 u16addr, uint8 *u8data)
+uint8 EEPROM_writeBlock(uint16 u16addr, const uint8 *data, uint16 len)
 {
-	/* Send the Start Bit */
-    TWI_start();
-    if (TWI_getStatus() != TWI_START)
-        return ERROR;
+    TWI_TransactionType transaction;
+    uint8 chunk;
 
-    /* Send the device address, we need to get A8 A9 A10 address bits from the
-     * memory location address and R/W=0 (write) */
-    TWI_writeByte((uint8)((0xA0) | ((u16addr & 0x0700)>>7)));
-    if (TWI_getStatus() != TWI_MT_SLA_W_ACK)
-        return ERROR;
+    while (len > 0)
+    {
+        /* One transaction per page, each one waits for the previous write cycle */
+        chunk = EEPROM_submitPageWrite(&transaction, u16addr, data, len, NULL_PTR);
+        if ((chunk == 0) || !TWI_wait(&transaction))
+            return ERROR;
 
-    /* Send the required memory location address */
-    TWI_writeByte((uint8)(u16addr));
-    if (TWI_getStatus() != TWI_MT_DATA_ACK)
-        return ERROR;
+        u16addr += chunk;
+        data += chunk;
+        len -= chunk;
+    }
 
-    /* Send the Repeated Start Bit */
-    TWI_start();
-    if (TWI_getStatus() != TWI_REP_START)
+    /* Poll until the last write cycle is over so the data is committed on return */
+    EEPROM_setup(&transaction, u16addr, NULL_PTR);
+    transaction.flags = TWI_FLAG_ACK_POLL;
+    if (!TWI_submit(&transaction) || !TWI_wait(&transaction))
         return ERROR;
 
-    /* Send the device address, we need to get A8 A9 A10 address bits from the
-     * memory location address and R/W=1 (Read) */
-    TWI_writeByte((uint8)((0xA0) | ((u16addr & 0x0700)>>7) | 1));
-    if (TWI_getStatus() != TWI_MT_SLA_R_ACK)
-        return ERROR;
+    return SUCCESS;
+}
 
-    /* Read Byte from Memory without send ACK */
-    *u8data = TWI_readByteWithNACK();
-    if (TWI_getStatus() != TWI_MR_DATA_NACK)
-        return ERROR;
+uint8 EEPROM_writeByte(uint16 u16addr, uint8 u8data)
+{
+    return EEPROM_writeBlock(u16addr, &u8data, 1);
+}
 
-    /* Send the Stop Bit */
-    TWI_stop();
+uint8 EEPROM_readBlock(uint16 u16addr, uint8 *data, uint16 len)
+{
+    TWI_TransactionType transaction;
+
+    if (len == 0)
+        return SUCCESS;
+
+    /* Sequential read: the engine ACKs every byte but the last one */
+    if (!EEPROM_submitRead(&transaction, u16addr, data, len, NULL_PTR) ||
+        !TWI_wait(&transaction))
+        return ERROR;
 
     return SUCCESS;
 }
+
+uint8 EEPROM_readByte(uint16 u16addr, uint8 *u8data)
+{
+    return EEPROM_readBlock(u16addr, u8data, 1);
+}
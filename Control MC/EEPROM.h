@@ -2,6 +2,7 @@
 #define EEPROM_H_
 
 #include "std_types.h"
+#include "I2C.h"
 
 /*******************************************************************************
  *                      Preprocessor Macros                                    *
@@ -9,11 +10,69 @@
 #define ERROR 0
 #define SUCCESS 1
 
+/* 24C16: 2 KB organised in 16-byte pages, A8..A10 go in the device address */
+#define EEPROM_SIZE            2048
+#define EEPROM_PAGE_SIZE       16
+
+/*
+ * Memory map, regions are page aligned:
+ *   0x000 - 0x0FF  Configuration (0x000 holds the password of the first firmware until migrated,
+ *                  0x010 the user table salt, 0x020 / 0x030 the settings A/B slots)
+ *   0x100 - 0x1FF  Credential log (Credential.c)
+ *   0x200 - 0x5FF  User table (UserTable.c)
+ *   0x600 - 0x7FF  Audit log (AuditLog.c)
+ */
+#define EEPROM_CONFIG_START          0x000
+#define EEPROM_CONFIG_SIZE           0x100
+#define EEPROM_USER_SALT_ADDRESS     0x010
+#define EEPROM_SETTINGS_SLOT_A       0x020
+#define EEPROM_SETTINGS_SLOT_B       0x030
+#define EEPROM_CREDENTIAL_LOG_START  0x100
+#define EEPROM_CREDENTIAL_LOG_SIZE   0x100
+#define EEPROM_USER_TABLE_START      0x200
+#define EEPROM_USER_TABLE_SIZE       0x400
+#define EEPROM_AUDIT_LOG_START       0x600
+#define EEPROM_AUDIT_LOG_SIZE        0x200
+
 /*******************************************************************************
  *                      Functions Prototypes                                   *
  *******************************************************************************/
 
+/*
+ * Blocking accesses: they queue transactions on the interrupt driven TWI
+ * engine and wait for them, the UART and timer interrupts keep running.
+ */
 uint8 EEPROM_writeByte(uint16 u16addr,uint8 u8data);
 uint8 EEPROM_readByte(uint16 u16addr,uint8 *u8data);
 
+/*
+ * Write len bytes starting at u16addr. The buffer is split along page
+ * boundaries, each page is sent in one transaction and the end of the write
+ * cycle is detected by ACK polling, so the data is committed on return.
+ */
+uint8 EEPROM_writeBlock(uint16 u16addr, const uint8 *data, uint16 len);
+
+/*
+ * Read len bytes starting at u16addr in one sequential read transaction:
+ * every byte but the last is acknowledged so the EEPROM keeps sending.
+ */
+uint8 EEPROM_readBlock(uint16 u16addr, uint8 *data, uint16 len);
+
+/*
+ * Non blocking sequential read: queue it and return, the callback (may be
+ * NULL_PTR) is called from the TWI interrupt once the data is in the buffer.
+ * The transaction and the buffer must stay valid until then.
+ * Returns FALSE if the TWI queue is full.
+ */
+boolean EEPROM_submitRead(TWI_TransactionType *transaction, uint16 u16addr,
+		uint8 *data, uint16 len, TWI_CallbackType callback);
+
+/*
+ * Non blocking page write: queues the part of the buffer that fits in the
+ * page of u16addr and returns its length (0 if the TWI queue is full).
+ * The next transaction to the EEPROM waits for the write cycle by ACK polling.
+ */
+uint8 EEPROM_submitPageWrite(TWI_TransactionType *transaction, uint16 u16addr,
+		const uint8 *data, uint16 len, TWI_CallbackType callback);
+
 #endif /* EEPROM_H_ */
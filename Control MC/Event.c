@@ -0,0 +1,56 @@
+#include "Event.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define EVENT_QUEUE_MASK    (EVENT_QUEUE_SIZE - 1)
+
+/* Free running indexes, only the producers move the head and the main loop the tail */
+static volatile uint8 g_events[EVENT_QUEUE_SIZE];
+static volatile uint8 g_head = 0;
+static volatile uint8 g_tail = 0;
+
+void Event_init(void)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	g_head = 0;
+	g_tail = 0;
+	SREG = sreg;
+}
+
+boolean Event_post(uint8 event)
+{
+	boolean queued = FALSE;
+	uint8 sreg = SREG;
+
+	/* Producers are the ISRs and the main loop, keep them from interleaving */
+	cli();
+	if ((uint8)(g_head - g_tail) < EVENT_QUEUE_SIZE)
+	{
+		g_events[g_head & EVENT_QUEUE_MASK] = event;
+		g_head++;
+		queued = TRUE;
+	}
+	SREG = sreg;
+
+	return queued;
+}
+
+boolean Event_get(uint8 *event)
+{
+	uint8 tail = g_tail;
+
+	if (tail == g_head)
+	{
+		return FALSE;
+	}
+	*event = g_events[tail & EVENT_QUEUE_MASK];
+	g_tail = tail + 1;
+	return TRUE;
+}
+
+boolean Event_isPending(void)
+{
+	return (g_tail != g_head);
+}
@@ -0,0 +1,51 @@
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * FIFO of one byte events, posted from interrupts (timer callbacks) or the
+ * main loop and consumed by the main loop only. The meaning of the event
+ * codes is up to the application.
+ */
+#define EVENT_QUEUE_SIZE    16      /* Power of two, at most 128 */
+
+#if (EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) != 0 || (EVENT_QUEUE_SIZE > 128)
+#error "EVENT_QUEUE_SIZE must be a power of two up to 128"
+#endif
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Empty the queue.
+ */
+void Event_init(void);
+
+/*
+ * Description :
+ * Queue an event, safe to call from an ISR.
+ * Returns FALSE if the queue is full, the event is then dropped.
+ */
+boolean Event_post(uint8 event);
+
+/*
+ * Description :
+ * Take the oldest event without waiting.
+ * Returns FALSE if the queue is empty.
+ */
+boolean Event_get(uint8 *event);
+
+/*
+ * Description :
+ * Return TRUE if an event is queued, without taking it.
+ */
+boolean Event_isPending(void);
+
+#endif /* EVENT_H_ */
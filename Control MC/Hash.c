@@ -0,0 +1,145 @@
+#include "Hash.h"
+
+/* 32-bit arithmetic, the masks keep host builds (64-bit long) exact and cost nothing on AVR */
+#define HASH_U32(X)         ((uint32)(X) & 0xFFFFFFFFUL)
+#define HASH_ROTL(X, N)     HASH_U32(((X) << (N)) | (HASH_U32(X) >> (32 - (N))))
+
+#define HASH_ROUND(V0, V1, V2, V3)  \
+	do {                                                                          \
+		V0 = HASH_U32(V0 + V1); V1 = HASH_ROTL(V1, 5);  V1 ^= V0; V0 = HASH_ROTL(V0, 16); \
+		V2 = HASH_U32(V2 + V3); V3 = HASH_ROTL(V3, 8);  V3 ^= V2;                     \
+		V0 = HASH_U32(V0 + V3); V3 = HASH_ROTL(V3, 7);  V3 ^= V0;                     \
+		V2 = HASH_U32(V2 + V1); V1 = HASH_ROTL(V1, 13); V1 ^= V2; V2 = HASH_ROTL(V2, 16); \
+	} while (0)
+
+/*
+ * Entropy pool, on the target it is left out of the startup clearing so the
+ * random power-up content of the SRAM is mixed in as well.
+ */
+#ifdef __AVR__
+static uint8 g_pool[HASH_KEY_SIZE] __attribute__((section(".noinit")));
+#else
+static uint8 g_pool[HASH_KEY_SIZE];
+#endif
+static uint8 g_poolIndex = 0;
+static uint8 g_poolSamples = 0;
+static uint32 g_counter = 0;
+
+static uint32 Hash_load(const uint8 *bytes)
+{
+	return (uint32)bytes[0] | ((uint32)bytes[1] << 8) |
+			((uint32)bytes[2] << 16) | ((uint32)bytes[3] << 24);
+}
+
+void Hash_compute(const uint8 *key, const uint8 *data, uint8 length, uint8 *digest)
+{
+	uint32 k0 = Hash_load(key);
+	uint32 k1 = Hash_load(key + 4);
+	uint32 v0 = k0;
+	uint32 v1 = k1;
+	uint32 v2 = 0x6c796765UL ^ k0;
+	uint32 v3 = 0x74656462UL ^ k1;
+	uint32 m;
+	uint8 left = length;
+
+	/* Compression, 2 rounds per 4-byte block */
+	for (; left >= 4; left -= 4, data += 4)
+	{
+		m = Hash_load(data);
+		v3 ^= m;
+		HASH_ROUND(v0, v1, v2, v3);
+		HASH_ROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	/* Last block: the remaining bytes and the length in the top byte */
+	m = (uint32)length << 24;
+	switch (left)
+	{
+	case 3: m |= (uint32)data[2] << 16; /* fall through */
+	case 2: m |= (uint32)data[1] << 8;  /* fall through */
+	case 1: m |= (uint32)data[0];       /* fall through */
+	default: break;
+	}
+	m = HASH_U32(m);
+	v3 ^= m;
+	HASH_ROUND(v0, v1, v2, v3);
+	HASH_ROUND(v0, v1, v2, v3);
+	v0 ^= m;
+
+	/* Finalization, 4 rounds */
+	v2 ^= 0xFF;
+	HASH_ROUND(v0, v1, v2, v3);
+	HASH_ROUND(v0, v1, v2, v3);
+	HASH_ROUND(v0, v1, v2, v3);
+	HASH_ROUND(v0, v1, v2, v3);
+
+	m = v1 ^ v3;
+	digest[0] = (uint8)m;
+	digest[1] = (uint8)(m >> 8);
+	digest[2] = (uint8)(m >> 16);
+	digest[3] = (uint8)(m >> 24);
+}
+
+boolean Hash_equal(const uint8 *a, const uint8 *b, uint8 length)
+{
+	uint8 difference = 0;
+	uint8 i;
+
+	/* No early exit: every byte is compared whatever the first mismatch */
+	for (i = 0; i < length; ++i)
+	{
+		difference |= a[i] ^ b[i];
+	}
+	return (difference == 0);
+}
+
+void Hash_addEntropy(uint8 sample)
+{
+	g_pool[g_poolIndex] = (uint8)((g_pool[g_poolIndex] << 1) | (g_pool[g_poolIndex] >> 7)) ^ sample;
+	g_poolIndex = (uint8)((g_poolIndex + 1) % HASH_KEY_SIZE);
+	if (g_poolSamples < HASH_SEED_SAMPLES)
+	{
+		g_poolSamples++;
+	}
+}
+
+boolean Hash_isSeeded(void)
+{
+	return (g_poolSamples >= HASH_SEED_SAMPLES);
+}
+
+boolean Hash_random(uint8 *buffer, uint8 length)
+{
+	uint8 counter[4];
+	uint8 block[HASH_DIGEST_SIZE];
+	uint8 i;
+
+	if (!Hash_isSeeded())
+	{
+		return FALSE;
+	}
+
+	while (length != 0)
+	{
+		/* Counter mode keyed by the pool */
+		g_counter++;
+		counter[0] = (uint8)g_counter;
+		counter[1] = (uint8)(g_counter >> 8);
+		counter[2] = (uint8)(g_counter >> 16);
+		counter[3] = (uint8)(g_counter >> 24);
+		Hash_compute(g_pool, counter, sizeof(counter), block);
+		for (i = 0; (i < HASH_DIGEST_SIZE) && (length != 0); ++i, --length)
+		{
+			*buffer++ = block[i];
+		}
+	}
+
+	/* Rekey so the returned bytes can't be linked to the next ones */
+	Hash_compute(g_pool, counter, sizeof(counter), block);
+	for (i = 0; i < HASH_DIGEST_SIZE; ++i)
+	{
+		g_pool[i] ^= block[i];
+	}
+	return TRUE;
+}
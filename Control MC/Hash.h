@@ -0,0 +1,60 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * HalfSipHash-2-4: the SipHash construction on 32-bit words, meant for 8 and
+ * 16-bit CPUs. Every operation is an add, a xor or a rotation of a 32-bit
+ * word, and most rotations are whole bytes, which avr-gcc turns into register moves.
+ */
+#define HASH_KEY_SIZE       8
+#define HASH_DIGEST_SIZE    4
+
+/*
+ * Samples mixed into the entropy pool before Hash_random draws salts, each
+ * sample is only trusted for about one bit.
+ */
+#define HASH_SEED_SAMPLES   128
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Compute the HalfSipHash-2-4 digest of data with key (the salt).
+ */
+void Hash_compute(const uint8 *key, const uint8 *data, uint8 length, uint8 *digest);
+
+/*
+ * Description :
+ * Compare two buffers in a time that only depends on length.
+ */
+boolean Hash_equal(const uint8 *a, const uint8 *b, uint8 length);
+
+/*
+ * Description :
+ * Mix an unpredictable sample (e.g. ADC noise, or the time a frame arrives)
+ * into the entropy pool used by Hash_random.
+ */
+void Hash_addEntropy(uint8 sample);
+
+/*
+ * Description :
+ * Return TRUE once HASH_SEED_SAMPLES samples were mixed into the pool.
+ */
+boolean Hash_isSeeded(void);
+
+/*
+ * Description :
+ * Fill buffer with bytes derived from the entropy pool, used for salts.
+ * Returns FALSE, and leaves buffer untouched, until the pool is seeded.
+ */
+boolean Hash_random(uint8 *buffer, uint8 length);
+
+#endif /* HASH_H_ */
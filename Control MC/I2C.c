@@ -1,12 +1,189 @@
 #include "I2C.h"
 #include "common_macros.h"
+#include "GPIO.h"
+#include "Timer.h" /* For the transaction budgets */
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+
+#define TWI_QUEUE_MASK  (TWI_QUEUE_SIZE - 1)
+
+/* TWCR values used by the interrupt driven engine */
+#define TWI_CR_START    ((1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE))
+#define TWI_CR_NEXT     ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWI_CR_ACK      ((1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE))
+#define TWI_CR_STOP     ((1 << TWINT) | (1 << TWSTO) | (1 << TWEN))
+
+/* Queue of pending transactions, the head one is on the bus */
+static TWI_TransactionType * volatile g_queue[TWI_QUEUE_SIZE];
+static volatile uint8 g_queueHead = 0;
+static volatile uint8 g_queueTail = 0;
+
+/* Progress of the transaction on the bus */
+static uint16 g_index = 0;          /* Next byte of the write or read buffer */
+static boolean g_subAddressSent = FALSE;
+static boolean g_readPhase = FALSE;
+static boolean g_polling = FALSE;
+static uint32 g_pollDeadline = 0;
+static volatile uint32 g_deadline = 0;  /* Timer_getMicros value the running transaction must end by */
+
+/*
+ * Budget of a transaction in microseconds, from the steps of its path.
+ */
+static uint32 TWI_budget(const TWI_TransactionType *transaction)
+{
+    /* START, SLA+W and STOP */
+    uint32 steps = 3 + transaction->write_length;
+
+    if (transaction->flags & TWI_FLAG_SUB_ADDRESS)
+    {
+        steps++;
+    }
+    if (transaction->read_length != 0)
+    {
+        /* Repeated START and SLA+R */
+        steps += 2 + transaction->read_length;
+    }
+
+    return (steps * TWI_STEP_US) + TWI_SLACK_US +
+           ((transaction->flags & TWI_FLAG_ACK_POLL) ? TWI_ACK_POLL_US : 0);
+}
+
+/*
+ * Start the transaction at the head of the queue.
+ * with_stop: end the previous transaction with a STOP in the same TWCR write.
+ */
+static void TWI_startNext(boolean with_stop)
+{
+    g_index = 0;
+    g_subAddressSent = FALSE;
+    g_readPhase = FALSE;
+    g_polling = FALSE;
+    g_deadline = Timer_getMicros() + TWI_budget(g_queue[g_queueTail & TWI_QUEUE_MASK]);
+    g_queue[g_queueTail & TWI_QUEUE_MASK]->status = TWI_BUSY;
+
+    /* TWSTO + TWSTA generates a STOP followed by a START */
+    TWCR = with_stop ? (TWI_CR_START | (1 << TWSTO)) : TWI_CR_START;
+}
+
+/*
+ * Finish the running transaction, then start the next queued one or release the bus.
+ */
+static void TWI_complete(TWI_TransactionStatusType status)
+{
+    TWI_TransactionType *transaction = g_queue[g_queueTail & TWI_QUEUE_MASK];
+
+    g_queueTail++;
+    transaction->status = status;
+
+    /* Drive the bus first so a callback submitting a new transaction sees a consistent state */
+    if (g_queueTail != g_queueHead)
+    {
+        TWI_startNext(TRUE);
+    }
+    else
+    {
+        TWCR = TWI_CR_STOP;
+    }
+
+    if (transaction->callback != NULL_PTR)
+    {
+        transaction->callback(transaction);
+    }
+}
+
+/*
+ * One step of the engine, called each time TWINT is set.
+ */
+static void TWI_service(void)
+{
+    TWI_TransactionType *transaction = g_queue[g_queueTail & TWI_QUEUE_MASK];
+    uint8 status = TWI_getStatus();
+
+    switch (status)
+    {
+    case TWI_START:
+    case TWI_REP_START:
+        TWDR = g_readPhase ? (transaction->address | 1) : transaction->address;
+        TWCR = TWI_CR_NEXT;
+        break;
+
+    case TWI_MT_SLA_W_ACK:
+    case TWI_MT_DATA_ACK:
+        if ((transaction->flags & TWI_FLAG_SUB_ADDRESS) && !g_subAddressSent)
+        {
+            g_subAddressSent = TRUE;
+            TWDR = transaction->sub_address;
+            TWCR = TWI_CR_NEXT;
+        }
+        else if (g_index < transaction->write_length)
+        {
+            TWDR = transaction->write_buffer[g_index++];
+            TWCR = TWI_CR_NEXT;
+        }
+        else if (transaction->read_length != 0)
+        {
+            /* Repeated start to turn the bus around */
+            g_index = 0;
+            g_readPhase = TRUE;
+            TWCR = TWI_CR_START;
+        }
+        else
+        {
+            TWI_complete(TWI_DONE);
+        }
+        break;
+
+    case TWI_MT_SLA_W_NACK:
+        /* Slave busy (EEPROM write cycle), poll it again with a repeated start */
+        if ((transaction->flags & TWI_FLAG_ACK_POLL) && !g_polling)
+        {
+            g_polling = TRUE;
+            g_pollDeadline = Timer_getMicros() + TWI_ACK_POLL_US;
+            TWCR = TWI_CR_START;
+        }
+        else if (g_polling && !Timer_isExpiredMicros(g_pollDeadline))
+        {
+            TWCR = TWI_CR_START;
+        }
+        else
+        {
+            transaction->error = status;
+            TWI_complete(TWI_FAILED);
+        }
+        break;
+
+    case TWI_MT_SLA_R_ACK:
+        /* ACK every byte but the last one */
+        TWCR = (transaction->read_length > 1) ? TWI_CR_ACK : TWI_CR_NEXT;
+        break;
+
+    case TWI_MR_DATA_ACK:
+        transaction->read_buffer[g_index++] = TWDR;
+        TWCR = (g_index < transaction->read_length - 1) ? TWI_CR_ACK : TWI_CR_NEXT;
+        break;
+
+    case TWI_MR_DATA_NACK:
+        transaction->read_buffer[g_index++] = TWDR;
+        TWI_complete(TWI_DONE);
+        break;
+
+    default:
+        /* Data NACK, SLA+R NACK, arbitration lost or bus error */
+        transaction->error = status;
+        TWI_complete(TWI_FAILED);
+        break;
+    }
+}
+
+ISR(TWI_vect)
+{
+    TWI_service();
+}
 
 void TWI_init(const TWI_ConfigType *Config_Ptr)
 {
-    /* SCL Calculation using the user-defined Prescaler and Bit Rate
-     *
-     * SCL = (F_CPU / (16 + 2 * TWBR * Prescaler))
+    /* SCL = (F_CPU / (16 + 2 * TWBR * Prescaler)), both computed from TWI_SCL_FREQ
      *
      * Common SCL Speeds:
      *     Normal Mode       100 Kb/s
@@ -14,8 +191,8 @@ void TWI_init(const TWI_ConfigType *Config_Ptr)
      *     Fast Mode Plus    1 Mb/s
      *     High-Speed Mode   3.4 Mb/s (rarely used)
      */
-    TWBR = Config_Ptr->bit_rate;
-    TWSR = Config_Ptr->twi_pre;
+    TWBR = TWI_TWBR_VALUE;
+    TWSR = TWI_PRESCALER_BITS;
 
     /* Set the Two Wire Bus address for this device (used when it's a slave).
        General Call Recognition: Off */
@@ -25,73 +202,128 @@ void TWI_init(const TWI_ConfigType *Config_Ptr)
     TWCR = (1<<TWEN);
 }
 
-void TWI_start(void)
+/*
+ * Drive a TWI pin as an open drain output: low, or released to the pull-up.
+ */
+static void TWI_drivePin(uint8 pin, uint8 value)
 {
-    /*
-     * Clear the TWINT flag before sending the start bit (TWINT=1).
-     * Set the TWSTA bit to generate a start condition (TWSTA=1).
-     * Enable the TWI module (TWEN=1).
-     */
-    TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
-
-    /* Wait for the TWINT flag to be set, indicating the start bit was sent */
-    while(BIT_IS_CLEAR(TWCR,TWINT));
+    if (value == LOGIC_LOW)
+    {
+        GPIO_writePin(TWI_PORT_ID, pin, LOGIC_LOW);
+        GPIO_setupPinDirection(TWI_PORT_ID, pin, PIN_OUTPUT);
+    }
+    else
+    {
+        GPIO_setupPinDirection(TWI_PORT_ID, pin, PIN_INPUT);
+    }
+    _delay_us(5); /* Half a 100 kHz clock period */
 }
 
-void TWI_stop(void)
+boolean TWI_recoverBus(void)
 {
-    /*
-     * Clear the TWINT flag before sending the stop bit (TWINT=1).
-     * Set the TWSTO bit to generate a stop condition (TWSTO=1).
-     * Enable the TWI module (TWEN=1).
-     */
-    TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
-}
+    uint8 pulse;
+    boolean released;
 
-void TWI_writeByte(uint8 data)
-{
-    /* Load the data byte into the TWI data register */
-    TWDR = data;
+    /* Disconnect the TWI module from the pins */
+    TWCR = 0;
+    TWI_drivePin(TWI_SDA_PIN_ID, LOGIC_HIGH);
+    TWI_drivePin(TWI_SCL_PIN_ID, LOGIC_HIGH);
 
-    /*
-     * Clear the TWINT flag before sending the data byte (TWINT=1).
-     * Enable the TWI module (TWEN=1).
-     */
-    TWCR = (1 << TWINT) | (1 << TWEN);
+    /* Up to 9 clocks let a slave finish the byte it is sending and release SDA */
+    for (pulse = 0; pulse < 9; ++pulse)
+    {
+        if (GPIO_readPin(TWI_PORT_ID, TWI_SDA_PIN_ID) == LOGIC_HIGH)
+            break;
+        TWI_drivePin(TWI_SCL_PIN_ID, LOGIC_LOW);
+        TWI_drivePin(TWI_SCL_PIN_ID, LOGIC_HIGH);
+    }
+
+    /* STOP condition: SDA rises while SCL is high */
+    TWI_drivePin(TWI_SCL_PIN_ID, LOGIC_LOW);
+    TWI_drivePin(TWI_SDA_PIN_ID, LOGIC_LOW);
+    TWI_drivePin(TWI_SCL_PIN_ID, LOGIC_HIGH);
+    TWI_drivePin(TWI_SDA_PIN_ID, LOGIC_HIGH);
+
+    released = (GPIO_readPin(TWI_PORT_ID, TWI_SDA_PIN_ID) == LOGIC_HIGH);
 
-    /* Wait for the TWINT flag to be set, indicating the data byte was sent */
-    while(BIT_IS_CLEAR(TWCR,TWINT));
+    /* Re-init: the bit rate and address registers are kept, enable the module again */
+    TWCR = (1<<TWEN);
+
+    return released;
 }
 
-uint8 TWI_readByteWithACK(void)
+boolean TWI_submit(TWI_TransactionType *transaction)
 {
-    /*
-     * Clear the TWINT flag before reading data (TWINT=1).
-     * Enable sending ACK after receiving data (TWEA=1).
-     * Enable the TWI module (TWEN=1).
-     */
-    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
+    uint8 sreg = SREG;
+    boolean idle;
 
-    /* Wait for the TWINT flag to be set, indicating data was received */
-    while(BIT_IS_CLEAR(TWCR,TWINT));
+    cli();
+    if ((uint8)(g_queueHead - g_queueTail) >= TWI_QUEUE_SIZE)
+    {
+        SREG = sreg;
+        return FALSE;
+    }
+    transaction->status = TWI_PENDING;
+    transaction->error = 0;
+    idle = (g_queueHead == g_queueTail);
+    g_queue[g_queueHead & TWI_QUEUE_MASK] = transaction;
+    g_queueHead++;
 
-    /* Return the received data byte */
-    return TWDR;
+    /* Kick the engine if the bus was released, otherwise it is chained on completion */
+    if (idle)
+    {
+        /* Let a STOP from a previous transaction finish first */
+        uint16 budget = TWI_DEFAULT_BUDGET;
+        while (BIT_IS_SET(TWCR,TWSTO) && (budget-- != 0));
+        TWI_startNext(FALSE);
+    }
+    SREG = sreg;
+
+    return TRUE;
 }
 
-uint8 TWI_readByteWithNACK(void)
+boolean TWI_wait(TWI_TransactionType *transaction)
 {
-    /*
-     * Clear the TWINT flag before reading data (TWINT=1).
-     * Enable the TWI module (TWEN=1).
-     */
-    TWCR = (1 << TWINT) | (1 << TWEN);
+    while ((transaction->status == TWI_PENDING) || (transaction->status == TWI_BUSY))
+    {
+        /* With the global interrupts disabled run the engine by polling TWINT */
+        if (BIT_IS_CLEAR(SREG,7) && BIT_IS_SET(TWCR,TWINT))
+        {
+            TWI_service();
+        }
+        TWI_checkTimeout();
+    }
+    return (transaction->status == TWI_DONE);
+}
+
+void TWI_checkTimeout(void)
+{
+    TWI_TransactionType *transaction;
+    uint8 sreg = SREG;
+
+    cli();
+    if ((g_queueHead == g_queueTail) || !Timer_isExpiredMicros(g_deadline))
+    {
+        SREG = sreg;
+        return;
+    }
 
-    /* Wait for the TWINT flag to be set, indicating data was received */
-    while(BIT_IS_CLEAR(TWCR,TWINT));
+    /* Stuck: fail the running transaction, free the bus and carry on with the queue */
+    transaction = g_queue[g_queueTail & TWI_QUEUE_MASK];
+    g_queueTail++;
+    TWI_recoverBus();
+    transaction->error = TWI_STATUS_TIMEOUT;
+    transaction->status = TWI_FAILED;
+    if (g_queueTail != g_queueHead)
+    {
+        TWI_startNext(FALSE);
+    }
+    SREG = sreg;
 
-    /* Return the received data byte */
-    return TWDR;
+    if (transaction->callback != NULL_PTR)
+    {
+        transaction->callback(transaction);
+    }
 }
 
 uint8 TWI_getStatus(void)
@@ -11,6 +11,110 @@
 #define TWI_MT_DATA_ACK   0x28 /* Master transmitted data byte and received ACK */
 #define TWI_MR_DATA_ACK   0x50 /* Master received data byte and sent ACK */
 #define TWI_MR_DATA_NACK  0x58 /* Master received data byte but did not send ACK */
+#define TWI_MT_SLA_W_NACK 0x20 /* Master transmitted slave address (write request) and received NACK */
+#define TWI_MT_DATA_NACK  0x30 /* Master transmitted data byte and received NACK */
+#define TWI_ARB_LOST      0x38 /* Arbitration lost */
+#define TWI_MR_SLA_R_NACK 0x48 /* Master transmitted slave address (read request) and received NACK */
+
+/*
+ * SCL clock of the bus in Hz, override with -DTWI_SCL_FREQ=100000UL.
+ * The 24Cxx EEPROMs support Fast Mode (400 kHz).
+ */
+#ifndef TWI_SCL_FREQ
+#define TWI_SCL_FREQ      400000UL
+#endif
+
+/*
+ * SCL = F_CPU / (16 + 2 * TWBR * Prescaler)
+ *
+ * The smallest prescaler giving TWBR <= 255 is picked, and TWBR is rounded
+ * up so the bus never runs faster than TWI_SCL_FREQ.
+ */
+#define TWI_SCL_DIVIDER   ((F_CPU) / (TWI_SCL_FREQ))
+
+#if TWI_SCL_DIVIDER < 16
+#error "TWI_SCL_FREQ is too high for F_CPU (needs F_CPU >= 16 * SCL)"
+#elif ((TWI_SCL_DIVIDER - 16) / 2) <= 255
+#define TWI_PRESCALER_VALUE  1
+#define TWI_PRESCALER_BITS   0
+#elif ((TWI_SCL_DIVIDER - 16) / 8) <= 255
+#define TWI_PRESCALER_VALUE  4
+#define TWI_PRESCALER_BITS   1
+#elif ((TWI_SCL_DIVIDER - 16) / 32) <= 255
+#define TWI_PRESCALER_VALUE  16
+#define TWI_PRESCALER_BITS   2
+#elif ((TWI_SCL_DIVIDER - 16) / 128) <= 255
+#define TWI_PRESCALER_VALUE  64
+#define TWI_PRESCALER_BITS   3
+#else
+#error "TWI_SCL_FREQ is too low for F_CPU (TWBR overflows with prescaler 64)"
+#endif
+
+#define TWI_TWBR_VALUE    (((F_CPU) - 16UL * (TWI_SCL_FREQ) + 2UL * TWI_PRESCALER_VALUE * (TWI_SCL_FREQ) - 1UL) \
+                           / (2UL * TWI_PRESCALER_VALUE * (TWI_SCL_FREQ)))
+#define TWI_SCL_ACTUAL    ((F_CPU) / (16UL + 2UL * TWI_TWBR_VALUE * TWI_PRESCALER_VALUE))
+
+/* Rounding TWBR up must not leave the bus more than 10% below the requested clock */
+#if defined(TWI_PRESCALER_VALUE) && ((TWI_SCL_ACTUAL * 10UL) < ((TWI_SCL_FREQ) * 9UL))
+#error "TWI_SCL_FREQ cannot be reached within 10% with this F_CPU"
+#endif
+
+/* Not a TWSR code (low 3 bits are never set there): the transaction timed out */
+#define TWI_STATUS_TIMEOUT 0x01
+
+/*
+ * Time budgets of the engine, in microseconds.
+ *
+ * Every step of a transaction (START, SLA+R/W, one data byte, STOP) takes
+ * 9 SCL periods on the bus plus one pass through TWI_vect, which costs at
+ * most TWI_SERVICE_CYCLES CPU cycles including the entry and exit. A
+ * transaction gets TWI_STEP_US per step of its path plus TWI_SLACK_US for
+ * clock stretching and other interrupts delaying TWI_vect:
+ *
+ *     write:  START, SLA+W, [sub_address], write_length bytes, STOP
+ *     read:   + repeated START, SLA+R, read_length bytes
+ *     poll:   + TWI_ACK_POLL_US while the slave NACKs SLA+W
+ */
+#define TWI_SERVICE_CYCLES    160
+#define TWI_BIT_US            ((1000000UL + TWI_SCL_ACTUAL - 1UL) / TWI_SCL_ACTUAL)
+#define TWI_STEP_US           (9UL * TWI_BIT_US + ((TWI_SERVICE_CYCLES * 1000000UL + (F_CPU) - 1UL) / (F_CPU)))
+#define TWI_SLACK_US          500UL
+
+/*
+ * ACK polling is bounded by time, not by retries: the 24Cxx write cycle
+ * lasts at most 5 ms (tWR), the slave is given twice that.
+ */
+#define TWI_ACK_POLL_US       10000UL
+
+/*
+ * Budget of the wait for a pending STOP before a transaction is started, in
+ * loop iterations. TWI_BUDGET_US converts a time to iterations (one iteration
+ * is about TWI_POLL_LOOP_CYCLES CPU cycles), a STOP takes one step.
+ */
+#define TWI_POLL_LOOP_CYCLES  8
+#define TWI_BUDGET_US(US)     ((uint16)(((F_CPU) / 1000000UL) * (US) / TWI_POLL_LOOP_CYCLES))
+#define TWI_DEFAULT_BUDGET    TWI_BUDGET_US(TWI_STEP_US)
+
+/*
+ * Worst case cost of a failing transaction, after which TWI_wait returns:
+ * its path budget, plus TWI_ACK_POLL_US when polled, plus TWI_RECOVERY_US
+ * for TWI_recoverBus (up to 24 pin changes of 5 us each).
+ * A 16 byte polled page write at 400 kHz and 8 MHz: 20 steps of 47 us,
+ * 500 us of slack, 10 ms of polling and the recovery, about 11.6 ms.
+ */
+#define TWI_RECOVERY_US       (24UL * 5UL)
+
+/* TWI pins, driven as GPIOs by TWI_recoverBus */
+#define TWI_PORT_ID       PORTC_ID
+#define TWI_SCL_PIN_ID    PIN0_ID
+#define TWI_SDA_PIN_ID    PIN1_ID
+
+/* Number of queued transactions waiting for the bus (power of two) */
+#define TWI_QUEUE_SIZE    4
+
+/* Transaction flags */
+#define TWI_FLAG_SUB_ADDRESS  0x01 /* Send sub_address right after SLA+W (memory address) */
+#define TWI_FLAG_ACK_POLL     0x02 /* Retry SLA+W for TWI_ACK_POLL_US while the slave NACKs it (EEPROM write cycle) */
 
 /*******************************************************************************
  *                             Type Definitions                                *
@@ -19,19 +123,37 @@
 /* Data type for TWI (I2C) Address */
 typedef uint8     TWI_AddressType;
 
-/* Data type for TWI (I2C) Baud Rate */
-typedef uint32    TWI_BaudRateType;
-
-/* Enumeration for TWI (I2C) Prescaler options */
+/* State of a transaction (a zero initialised descriptor reads as done) */
 typedef enum{
-	TWI_PRE_1, TWI_PRE_4, TWI_PRE_16, TWI_PRE_64
-}TWI_PRESCALER;
+	TWI_DONE, TWI_FAILED, TWI_PENDING, TWI_BUSY
+}TWI_TransactionStatusType;
+
+struct TWI_Transaction;
+
+/* Completion callback, called from the TWI interrupt so it must be short */
+typedef void (*TWI_CallbackType)(struct TWI_Transaction *transaction);
+
+/*
+ * Transaction descriptor: SLA+W, [sub_address], write_buffer, then if
+ * read_length != 0 a repeated start, SLA+R and read_buffer, then STOP.
+ * The descriptor and its buffers must stay valid until it completes.
+ */
+typedef struct TWI_Transaction{
+	uint8            address;       /* Slave address byte with R/W = 0 (e.g. 0xA0) */
+	uint8            flags;         /* TWI_FLAG_xxx */
+	uint8            sub_address;   /* Sent first when TWI_FLAG_SUB_ADDRESS is set */
+	const uint8     *write_buffer;
+	uint16           write_length;
+	uint8           *read_buffer;
+	uint16           read_length;
+	TWI_CallbackType callback;      /* NULL_PTR if not needed */
+	volatile TWI_TransactionStatusType status;
+	volatile uint8   error;         /* TWSR status that made it fail */
+}TWI_TransactionType;
 
 /* Structure to hold TWI (I2C) Configuration settings */
 typedef struct{
 	TWI_AddressType  address;   /* Device address for TWI communication */
-	TWI_BaudRateType bit_rate;  /* Baud rate for communication */
-	TWI_PRESCALER    twi_pre;   /* Prescaler for clock generation */
 }TWI_ConfigType;
 
 /*******************************************************************************
@@ -46,41 +168,40 @@ typedef struct{
 void TWI_init(const TWI_ConfigType *Config_Ptr);
 
 /*
- * Function to generate a start condition on the TWI bus to begin communication.
- * Returns: void
+ * Function to free a stuck bus: the TWI module is disabled, SCL is clocked
+ * 9 times as a GPIO so a slave holding SDA low can finish its byte, a STOP
+ * is generated by hand and the TWI module is enabled again.
+ * Returns: TRUE if SDA is released (bus free) afterwards.
  */
-void TWI_start(void);
+boolean TWI_recoverBus(void);
 
 /*
- * Function to generate a stop condition on the TWI bus to end communication.
- * Returns: void
- */
-void TWI_stop(void);
-
-/*
- * Function to write a byte of data to the TWI bus.
- * data: The byte of data to write.
- * Returns: void
+ * Function to retrieve the current status of the TWI module.
+ * Returns: The status code of the TWI module.
  */
-void TWI_writeByte(uint8 data);
+uint8 TWI_getStatus(void);
 
 /*
- * Function to read a byte of data from the TWI bus and send ACK (acknowledge).
- * Returns: The byte of data read from the TWI bus with ACK.
+ * Function to queue a transaction for the interrupt driven engine.
+ * The bus is driven from TWI_vect in the background and the callback is
+ * called once the transaction is done or failed.
+ * Returns: FALSE if the queue is full.
  */
-uint8 TWI_readByteWithACK(void);
+boolean TWI_submit(TWI_TransactionType *transaction);
 
 /*
- * Function to read a byte of data from the TWI bus and send NACK (no acknowledge).
- * Returns: The byte of data read from the TWI bus with NACK.
+ * Function to wait until a submitted transaction completes.
+ * A transaction running past its budget is aborted (see TWI_checkTimeout).
+ * Returns: TRUE if it completed successfully.
  */
-uint8 TWI_readByteWithNACK(void);
+boolean TWI_wait(TWI_TransactionType *transaction);
 
 /*
- * Function to retrieve the current status of the TWI module.
- * Returns: The status code of the TWI module.
+ * Function to abort the running transaction if it ran past its budget:
+ * it fails with error TWI_STATUS_TIMEOUT, the bus is recovered and the queue restarted.
+ * Called by TWI_wait, and periodically by users of the non blocking API.
  */
-uint8 TWI_getStatus(void);
+void TWI_checkTimeout(void);
 
 
 #endif /* I2C_H_ */
@@ -0,0 +1,122 @@
+#ifndef LINK_H_
+#define LINK_H_
+
+#include "std_types.h"
+#include "Frame.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* Time given to the peer to answer a command before it is considered lost */
+#define LINK_RESPONSE_TIMEOUT_MS   500
+
+/* Time to wait for a LINK_ACK before retransmitting, and the number of retransmissions */
+#define LINK_ACK_TIMEOUT_MS        100
+#define LINK_MAX_RETRIES           3
+
+/* From the first transmission of a reliable frame to its last retransmission */
+#define LINK_RETRY_SPAN_MS         ((LINK_MAX_RETRIES + 1) * LINK_ACK_TIMEOUT_MS)
+
+/* Frames received while Link_sendReliable waits for its LINK_ACK, kept for Link_poll */
+#define LINK_PENDING_FRAMES        2
+
+/*
+ * A frame's LENGTH and payload are read as one block once its header is in,
+ * a peer stopping in the middle is given up after this time (a full payload
+ * takes 35 ms at 9600 baud).
+ */
+#define LINK_BLOCK_TIMEOUT_MS      50
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Reset the frame parser and the transmit sequence number.
+ * Must be called after UART_init.
+ */
+void Link_init(void);
+
+/*
+ * Description :
+ * Send one frame with the next sequence number through the UART.
+ */
+void Link_send(uint8 type, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Send one frame asking for an acknowledgement and wait for the LINK_ACK,
+ * retransmitting it up to LINK_MAX_RETRIES times.
+ * The receiver only acknowledges once the frame is handed to its application,
+ * so the sender never runs ahead of it and no fixed delays are needed.
+ * Returns TRUE if the frame was acknowledged.
+ */
+boolean Link_sendReliable(uint8 type, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Return the time in microseconds between the last acknowledged
+ * Link_sendReliable transmission and its LINK_ACK.
+ */
+uint32 Link_getRoundTrip(void);
+
+/*
+ * Description :
+ * Feed the bytes waiting in the UART RX buffer to the frame parser without waiting.
+ * Returns TRUE and copies the frame if a complete valid frame was received.
+ * Frames asking for an acknowledgement are acknowledged here, and their
+ * retransmissions are acknowledged again but not delivered twice.
+ */
+boolean Link_poll(Frame_Type *frame);
+
+/*
+ * Description :
+ * Wait until a complete valid frame is received.
+ */
+void Link_receive(Frame_Type *frame);
+
+/*
+ * Description :
+ * Wait at most ms milliseconds for a complete valid frame.
+ * On timeout any partially received frame is discarded so the parser
+ * resynchronises on the next SYNC byte, and FALSE is returned.
+ */
+boolean Link_receiveTimeout(Frame_Type *frame, uint16 ms);
+
+/*
+ * Description :
+ * Discard any partially received frame, the parser then resynchronises on
+ * the next SYNC byte, and restart both sequence numbers so a peer that
+ * rebooted isn't taken for a retransmission. For callers polling with
+ * Link_poll: only call it after the line was idle for more than
+ * LINK_RETRY_SPAN_MS, or a late retransmission would be delivered twice.
+ */
+void Link_resync(void);
+
+/*
+ * Description :
+ * Return the number of line errors (UART framing/overrun errors and
+ * dropped frames) since the last valid frame and clear the counter.
+ * Errors without a valid frame usually mean a baud rate mismatch.
+ */
+uint8 Link_takeErrors(void);
+
+/*
+ * Description :
+ * Initiator side of the baud rate negotiation (HMI ECU).
+ * Sends the local capability mask at 9600 baud, waits for the BAUD_SELECT
+ * answer and switches to the selected rate. Retries until the peer answers.
+ */
+void Link_negotiateRate(void);
+
+/*
+ * Description :
+ * Responder side of the baud rate negotiation (Control ECU).
+ * Answers a received BAUD_CAPS frame with the fastest rate both sides
+ * support and switches to it once the answer is transmitted.
+ */
+void Link_acceptRate(const Frame_Type *frame);
+
+#endif /* LINK_H_ */
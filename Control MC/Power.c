@@ -0,0 +1,60 @@
+#include "Power.h"
+#include "Timer.h"
+#include "common_macros.h"
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+
+#ifdef POWER_STATS
+/* Sleep time accumulated since g_windowStart, Power_idle only runs from the main loop */
+static uint32 g_sleepMicros = 0;
+static uint32 g_windowStart = 0;
+#endif
+
+void Power_idle(void)
+{
+	Power_idleUnless(NULL_PTR);
+}
+
+void Power_idleUnless(Power_PendingType pending)
+{
+#ifdef POWER_STATS
+	uint32 start;
+#endif
+
+	if (BIT_IS_CLEAR(SREG, 7))
+	{
+		return;
+	}
+#ifdef POWER_STATS
+	start = Timer_getMicros();
+#endif
+	set_sleep_mode(SLEEP_MODE_IDLE);
+
+	cli();
+	if ((pending == NULL_PTR) || !pending())
+	{
+		sleep_enable();
+		/* The instruction after SEI always runs first, a pending interrupt wakes the CPU right away */
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
+#ifdef POWER_STATS
+	/* Includes the interrupt that woke the CPU up, a few us at most */
+	g_sleepMicros += Timer_elapsedMicros(start);
+#endif
+}
+
+#ifdef POWER_STATS
+void Power_takeStats(Power_StatsType *stats)
+{
+	uint32 now = Timer_getMicros();
+
+	stats->sleep_us = g_sleepMicros;
+	stats->window_us = now - g_windowStart;
+	g_sleepMicros = 0;
+	g_windowStart = now;
+}
+#endif
@@ -0,0 +1,101 @@
+#include "Settings.h"
+#include "CRC.h"
+
+static const uint16 g_slotAddress[2] = { EEPROM_SETTINGS_SLOT_A, EEPROM_SETTINGS_SLOT_B };
+
+static Settings_Type g_settings = {
+	SETTINGS_DEFAULT_DOOR_SECONDS,
+	SETTINGS_DEFAULT_LOCKOUT_SECONDS,
+	SETTINGS_DEFAULT_MAX_ATTEMPTS
+};
+
+/* Slot and sequence of the cached record, the next update goes to the other slot */
+static uint8 g_slot = 1;
+static uint8 g_sequence = 0xFF;
+
+/*
+ * Parse and range check a payload. Returns FALSE if a value is invalid.
+ */
+static boolean Settings_decode(const uint8 *payload, Settings_Type *settings)
+{
+	settings->door_seconds = payload[CONFIG_DOOR_OFFSET];
+	settings->lockout_seconds = (uint16)payload[CONFIG_LOCKOUT_OFFSET] |
+			((uint16)payload[CONFIG_LOCKOUT_OFFSET + 1] << 8);
+	settings->max_attempts = payload[CONFIG_ATTEMPTS_OFFSET];
+
+	return (settings->door_seconds != 0) &&
+			(settings->lockout_seconds != 0) && (settings->lockout_seconds <= SETTINGS_MAX_LOCKOUT_SECONDS) &&
+			(settings->max_attempts != 0) && (settings->max_attempts <= SETTINGS_MAX_ATTEMPTS);
+}
+
+void Settings_init(void)
+{
+	uint8 record[SETTINGS_RECORD_SIZE];
+	Settings_Type settings;
+	boolean found = FALSE;
+	uint8 slot;
+
+	for (slot = 0; slot < 2; ++slot)
+	{
+		if ((EEPROM_readBlock(g_slotAddress[slot], record, SETTINGS_RECORD_SIZE) == ERROR) ||
+			(record[0] != SETTINGS_MAGIC) || (record[1] != SETTINGS_VERSION) ||
+			(CRC8_compute(record, SETTINGS_RECORD_SIZE - 1) != record[SETTINGS_RECORD_SIZE - 1]) ||
+			!Settings_decode(&record[SETTINGS_PAYLOAD_OFFSET], &settings))
+		{
+			continue;
+		}
+		if (found && ((sint8)(record[SETTINGS_SEQUENCE_OFFSET] - g_sequence) <= 0))
+		{
+			continue;
+		}
+		g_settings = settings;
+		g_slot = slot;
+		g_sequence = record[SETTINGS_SEQUENCE_OFFSET];
+		found = TRUE;
+	}
+}
+
+const Settings_Type *Settings_get(void)
+{
+	return &g_settings;
+}
+
+uint8 Settings_set(const uint8 *payload)
+{
+	uint8 record[SETTINGS_RECORD_SIZE];
+	Settings_Type settings;
+	uint8 slot = g_slot ^ 1;
+	uint8 i;
+
+	if (!Settings_decode(payload, &settings))
+	{
+		return ERROR;
+	}
+
+	record[0] = SETTINGS_MAGIC;
+	record[1] = SETTINGS_VERSION;
+	record[SETTINGS_SEQUENCE_OFFSET] = (uint8)(g_sequence + 1);
+	for (i = 0; i < CONFIG_PAYLOAD_LENGTH; ++i)
+	{
+		record[SETTINGS_PAYLOAD_OFFSET + i] = payload[i];
+	}
+	record[SETTINGS_RECORD_SIZE - 1] = CRC8_compute(record, SETTINGS_RECORD_SIZE - 1);
+
+	/* Blocking write: the cache only switches once the record is committed */
+	if (EEPROM_writeBlock(g_slotAddress[slot], record, SETTINGS_RECORD_SIZE) == ERROR)
+	{
+		return ERROR;
+	}
+	g_settings = settings;
+	g_slot = slot;
+	g_sequence = record[SETTINGS_SEQUENCE_OFFSET];
+	return SUCCESS;
+}
+
+void Settings_encode(uint8 *payload)
+{
+	payload[CONFIG_DOOR_OFFSET] = g_settings.door_seconds;
+	payload[CONFIG_LOCKOUT_OFFSET] = (uint8)g_settings.lockout_seconds;
+	payload[CONFIG_LOCKOUT_OFFSET + 1] = (uint8)(g_settings.lockout_seconds >> 8);
+	payload[CONFIG_ATTEMPTS_OFFSET] = g_settings.max_attempts;
+}
@@ -0,0 +1,77 @@
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include "std_types.h"
+#include "Frame.h"
+#include "EEPROM.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Settings record, kept in two slots (A/B). An update goes to the slot that
+ * doesn't hold the current record, so a power loss during the write leaves
+ * the previous settings intact:
+ *
+ *   | MAGIC | VERSION | SEQUENCE | CONFIG_DATA payload | CRC-8 |
+ *
+ * The valid record of the current VERSION with the newest SEQUENCE
+ * (compared modulo 256) wins, the defaults apply if there is none.
+ */
+#define SETTINGS_MAGIC            0x5E
+#define SETTINGS_VERSION          1
+#define SETTINGS_SEQUENCE_OFFSET  2
+#define SETTINGS_PAYLOAD_OFFSET   3
+#define SETTINGS_RECORD_SIZE      (SETTINGS_PAYLOAD_OFFSET + CONFIG_PAYLOAD_LENGTH + 1)
+
+/* Defaults */
+#define SETTINGS_DEFAULT_DOOR_SECONDS     15
+#define SETTINGS_DEFAULT_LOCKOUT_SECONDS  60
+#define SETTINGS_DEFAULT_MAX_ATTEMPTS     3
+
+/* Accepted ranges */
+#define SETTINGS_MAX_LOCKOUT_SECONDS      3600
+#define SETTINGS_MAX_ATTEMPTS             9
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef struct {
+	uint8  door_seconds;      /* Door opening time, closing takes as long */
+	uint16 lockout_seconds;   /* Alarm and keypad lockout */
+	uint8  max_attempts;      /* Wrong passwords in a row before the lockout */
+} Settings_Type;
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Read both slots and cache the newest valid settings. Called once at boot.
+ */
+void Settings_init(void);
+
+/*
+ * Description :
+ * Return the cached settings.
+ */
+const Settings_Type *Settings_get(void);
+
+/*
+ * Description :
+ * Validate a CONFIG_SET payload, write it to the spare slot and switch the
+ * cache to it once the write is committed.
+ * Returns SUCCESS, or ERROR if a value is out of range or the write failed.
+ */
+uint8 Settings_set(const uint8 *payload);
+
+/*
+ * Description :
+ * Fill a CONFIG_DATA payload (CONFIG_PAYLOAD_LENGTH bytes) from the cache.
+ */
+void Settings_encode(uint8 *payload);
+
+#endif /* SETTINGS_H_ */
@@ -0,0 +1,142 @@
+#include "SoftTimer.h"
+#include "Timer.h"
+#include "Power.h"
+#include "common_macros.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define SOFT_TIMER_WHEEL_MASK   (SOFT_TIMER_WHEEL_SIZE - 1)
+
+/* One list of timers per slot, the tick advances g_wheelIndex by one slot per ms */
+static SoftTimer_Type *g_wheel[SOFT_TIMER_WHEEL_SIZE];
+static volatile uint8 g_wheelIndex = 0;
+
+/*
+ * Link a timer due in ms milliseconds, interrupts disabled.
+ */
+static void SoftTimer_insert(SoftTimer_Type *timer, uint32 ms)
+{
+	uint8 slot;
+
+	if (ms == 0)
+	{
+		ms = 1;
+	}
+	else if (ms > SOFT_TIMER_MAX_MS)
+	{
+		ms = SOFT_TIMER_MAX_MS;
+	}
+	slot = (uint8)((g_wheelIndex + ms) & SOFT_TIMER_WHEEL_MASK);
+	timer->slot = slot;
+	timer->rounds = (uint16)((ms - 1) / SOFT_TIMER_WHEEL_SIZE);
+
+	/* Insert at the head: a timer re-armed during the tick isn't seen again by that tick */
+	timer->previous = NULL_PTR;
+	timer->next = g_wheel[slot];
+	if (timer->next != NULL_PTR)
+	{
+		timer->next->previous = timer;
+	}
+	g_wheel[slot] = timer;
+	timer->running = TRUE;
+}
+
+/*
+ * Unlink a running timer, interrupts disabled.
+ */
+static void SoftTimer_unlink(SoftTimer_Type *timer)
+{
+	if (timer->previous != NULL_PTR)
+	{
+		timer->previous->next = timer->next;
+	}
+	else
+	{
+		g_wheel[timer->slot] = timer->next;
+	}
+	if (timer->next != NULL_PTR)
+	{
+		timer->next->previous = timer->previous;
+	}
+	timer->next = timer->previous = NULL_PTR;
+	timer->running = FALSE;
+}
+
+/*
+ * Tick callback (Timer2 interrupt): advance one slot and expire its due timers.
+ */
+static void SoftTimer_tick(void)
+{
+	SoftTimer_Type *timer;
+	SoftTimer_Type *next;
+
+	g_wheelIndex = (g_wheelIndex + 1) & SOFT_TIMER_WHEEL_MASK;
+	for (timer = g_wheel[g_wheelIndex]; timer != NULL_PTR; timer = next)
+	{
+		next = timer->next;
+		if (timer->rounds != 0)
+		{
+			timer->rounds--;
+			continue;
+		}
+		SoftTimer_unlink(timer);
+		timer->expired = TRUE;
+		if (timer->period != 0)
+		{
+			SoftTimer_insert(timer, timer->period);
+		}
+		if (timer->callback != NULL_PTR)
+		{
+			timer->callback();
+		}
+	}
+}
+
+void SoftTimer_init(void)
+{
+	Timer_setCallBack(SoftTimer_tick, TIMER2_ID);
+}
+
+void SoftTimer_start(SoftTimer_Type *timer, uint32 ms, uint16 period, SoftTimer_CallbackType callback)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	if (timer->running)
+	{
+		SoftTimer_unlink(timer);
+	}
+	timer->period = period;
+	timer->callback = callback;
+	timer->expired = FALSE;
+	SoftTimer_insert(timer, ms);
+	SREG = sreg;
+}
+
+void SoftTimer_stop(SoftTimer_Type *timer)
+{
+	uint8 sreg = SREG;
+
+	cli();
+	if (timer->running)
+	{
+		SoftTimer_unlink(timer);
+	}
+	SREG = sreg;
+}
+
+boolean SoftTimer_isExpired(const SoftTimer_Type *timer)
+{
+	return timer->expired;
+}
+
+void SoftTimer_delay(uint32 ms)
+{
+	SoftTimer_Type timer = { 0 };
+
+	SoftTimer_start(&timer, ms, 0, NULL_PTR);
+	while (!SoftTimer_isExpired(&timer))
+	{
+		Power_idle();
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef SOFTTIMER_H_
+#define SOFTTIMER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Software timers on the 1 ms system tick, kept in a hashed timing wheel:
+ * a timer due in d ms sits in slot (now + d) % SOFT_TIMER_WHEEL_SIZE with
+ * (d - 1) / SOFT_TIMER_WHEEL_SIZE rounds to go. Arming and stopping are a
+ * list insert / unlink, each tick only walks the timers of one slot.
+ */
+#define SOFT_TIMER_WHEEL_SIZE   64      /* Power of two */
+#define SOFT_TIMER_MAX_MS       ((uint32)0xFFFF * SOFT_TIMER_WHEEL_SIZE)
+
+#if (SOFT_TIMER_WHEEL_SIZE & (SOFT_TIMER_WHEEL_SIZE - 1)) != 0
+#error "SOFT_TIMER_WHEEL_SIZE must be a power of two"
+#endif
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/* Called from the tick interrupt: keep it short */
+typedef void (*SoftTimer_CallbackType)(void);
+
+/* Owned by the caller and linked in the wheel while it runs, zero-initialise it */
+typedef struct SoftTimer {
+	struct SoftTimer *next;
+	struct SoftTimer *previous;
+	uint16 rounds;                   /* Wheel turns left before expiry */
+	uint8 slot;                      /* Wheel slot holding the timer */
+	uint16 period;                   /* ms between expiries, 0 for a one-shot timer */
+	SoftTimer_CallbackType callback; /* May be NULL_PTR */
+	volatile boolean running;
+	volatile boolean expired;        /* Event flag, set on every expiry */
+} SoftTimer_Type;
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Hook the timer service on the system tick (Timer2 callback).
+ * Timer_startTick must be called as well.
+ */
+void SoftTimer_init(void);
+
+/*
+ * Description :
+ * (Re)arm a timer to expire in ms milliseconds (1..SOFT_TIMER_MAX_MS), then
+ * every period ms if period isn't 0. Clears the event flag.
+ */
+void SoftTimer_start(SoftTimer_Type *timer, uint32 ms, uint16 period, SoftTimer_CallbackType callback);
+
+/*
+ * Description :
+ * Stop a timer, nothing happens if it isn't running.
+ */
+void SoftTimer_stop(SoftTimer_Type *timer);
+
+/*
+ * Description :
+ * Return TRUE once the timer expired since it was started (the flag stays set).
+ */
+boolean SoftTimer_isExpired(const SoftTimer_Type *timer);
+
+/*
+ * Description :
+ * Wait for ms milliseconds on a private one-shot timer, sleeping in
+ * between the ticks.
+ */
+void SoftTimer_delay(uint32 ms);
+
+#endif /* SOFTTIMER_H_ */
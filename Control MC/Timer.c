@@ -1,13 +1,28 @@
 #include "Timer.h"
 #include "common_macros.h"
+#include "GPIO.h"
 #include <avr/io.h> /* To use the UART Registers */
 #include <avr/interrupt.h>
 
 
 /* Global variables to store the address of callback functions */
-static volatile void (*g_timer0CallbackPtr)(void) = NULL_PTR;
-static volatile void (*g_timer1CallbackPtr)(void) = NULL_PTR;
-static volatile void (*g_timer2CallbackPtr)(void) = NULL_PTR;
+static void (*volatile g_timer0CallbackPtr)(void) = NULL_PTR;
+static void (*volatile g_timer2CallbackPtr)(void) = NULL_PTR;
+/* Timer1 has one callback per interrupt source (Timer1_EventType) */
+static void (*volatile g_timer1CallbackPtr[TIMER1_EVENT_COUNT])(void);
+
+/* ICR1 value of the last input capture */
+static volatile uint16 g_timer1Capture = 0;
+
+/* TIMSK enable bit of each Timer1_EventType */
+static const uint8 g_timer1InterruptBit[TIMER1_EVENT_COUNT] = { OCIE1A, OCIE1B, TICIE1, TOIE1 };
+
+/* 1 ms system tick counter, only incremented once Timer_startTick is called */
+static volatile uint32 g_tickCount = 0;
+static volatile boolean g_tickRunning = FALSE;
+/* Seconds since Timer_startTick, counted from the ticks */
+static volatile uint32 g_seconds = 0;
+static volatile uint16 g_secondTicks = 0;
 
 /* ISR Definitions */
 ISR(TIMER0_OVF_vect)
@@ -28,17 +43,34 @@ ISR(TIMER0_COMP_vect)
 
 ISR(TIMER1_OVF_vect)
 {
-    if(g_timer1CallbackPtr != NULL_PTR)
+    if(g_timer1CallbackPtr[TIMER1_EVENT_OVERFLOW] != NULL_PTR)
     {
-        (*g_timer1CallbackPtr)();
+        (*g_timer1CallbackPtr[TIMER1_EVENT_OVERFLOW])();
     }
 }
 
 ISR(TIMER1_COMPA_vect)
 {
-    if(g_timer1CallbackPtr != NULL_PTR)
+    if(g_timer1CallbackPtr[TIMER1_EVENT_COMPARE_A] != NULL_PTR)
     {
-        (*g_timer1CallbackPtr)();
+        (*g_timer1CallbackPtr[TIMER1_EVENT_COMPARE_A])();
+    }
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+    if(g_timer1CallbackPtr[TIMER1_EVENT_COMPARE_B] != NULL_PTR)
+    {
+        (*g_timer1CallbackPtr[TIMER1_EVENT_COMPARE_B])();
+    }
+}
+
+ISR(TIMER1_CAPT_vect)
+{
+    g_timer1Capture = ICR1;
+    if(g_timer1CallbackPtr[TIMER1_EVENT_CAPTURE] != NULL_PTR)
+    {
+        (*g_timer1CallbackPtr[TIMER1_EVENT_CAPTURE])();
     }
 }
 
@@ -52,6 +84,15 @@ ISR(TIMER2_OVF_vect)
 
 ISR(TIMER2_COMP_vect)
 {
+    if(g_tickRunning)
+    {
+        g_tickCount++;
+        if(++g_secondTicks == 1000)
+        {
+            g_secondTicks = 0;
+            g_seconds++;
+        }
+    }
     if(g_timer2CallbackPtr != NULL_PTR)
     {
         (*g_timer2CallbackPtr)();
@@ -81,9 +122,11 @@ void Timer_init(const Timer_ConfigType * Config_Ptr)
         case TIMER1_ID:
             /* Set initial value */
             TCNT1 = Config_Ptr->timer_initialValue;
+            TCCR1A = 0;
+            TCCR1B = 0;
             if (Config_Ptr->timer_mode == TIMER_COMPARE_MODE) {
                 OCR1A = Config_Ptr->timer_compareMatchValue;
-                TCCR1A = (1<<WGM12); /* Set to CTC mode */
+                TCCR1B = (1<<WGM12); /* Set to CTC mode, WGM12 lives in TCCR1B */
             }
             TCCR1B = (TCCR1B & 0xF8) | (Config_Ptr->timer_clock);
             /* Enable interrupt */
@@ -121,8 +164,7 @@ void Timer_deInit(uint8 timer_ID)
         case TIMER1_ID:
             TCCR1A = 0;
             TCCR1B = 0;
-            CLEAR_BIT(TIMSK, OCIE1A);
-            CLEAR_BIT(TIMSK, TOIE1);
+            TIMSK &= ~((1<<OCIE1A) | (1<<OCIE1B) | (1<<TICIE1) | (1<<TOIE1));
             break;
         case TIMER2_ID:
             TCCR2 = 0;
@@ -140,7 +182,9 @@ void Timer_setCallBack(void(*a_ptr)(void), uint8 timer_ID)
             g_timer0CallbackPtr = a_ptr;
             break;
         case TIMER1_ID:
-            g_timer1CallbackPtr = a_ptr;
+            /* Timer_init enables either the compare A or the overflow interrupt */
+            g_timer1CallbackPtr[TIMER1_EVENT_COMPARE_A] = a_ptr;
+            g_timer1CallbackPtr[TIMER1_EVENT_OVERFLOW] = a_ptr;
             break;
         case TIMER2_ID:
             g_timer2CallbackPtr = a_ptr;
@@ -148,3 +192,172 @@ void Timer_setCallBack(void(*a_ptr)(void), uint8 timer_ID)
     }
 }
 
+void Timer1_init(const Timer1_ConfigType * Config_Ptr)
+{
+    /* Stop the clock while the mode and the compare values change */
+    TCCR1B = 0;
+    TCNT1 = 0;
+
+    switch(Config_Ptr->timer1_mode)
+    {
+        case TIMER1_CTC_MODE:
+            /* Mode 4: CTC with TOP = OCR1A */
+            TCCR1A = 0;
+            OCR1A = Config_Ptr->timer1_top;
+            OCR1B = Config_Ptr->timer1_compareB;
+            TCCR1B = (1<<WGM12) | (Config_Ptr->timer1_clock);
+            break;
+        case TIMER1_FAST_PWM_MODE:
+            /* Mode 14: Fast PWM with TOP = ICR1, clear OC1A/OC1B on compare match */
+            ICR1 = Config_Ptr->timer1_top;
+            OCR1A = Config_Ptr->timer1_compareA;
+            OCR1B = Config_Ptr->timer1_compareB;
+            GPIO_setupPinDirection(PORTD_ID, PIN5_ID, PIN_OUTPUT); /* OC1A */
+            GPIO_setupPinDirection(PORTD_ID, PIN4_ID, PIN_OUTPUT); /* OC1B */
+            TCCR1A = (1<<COM1A1) | (1<<COM1B1) | (1<<WGM11);
+            TCCR1B = (1<<WGM13) | (1<<WGM12) | (Config_Ptr->timer1_clock);
+            break;
+        case TIMER1_INPUT_CAPTURE_MODE:
+            /* Normal mode, noise canceler on, capture on the selected ICP1 edge */
+            GPIO_setupPinDirection(PORTD_ID, PIN6_ID, PIN_INPUT);
+            TCCR1A = 0;
+            TCCR1B = (1<<ICNC1) | ((Config_Ptr->timer1_edge == TIMER1_RISING_EDGE) ? (1<<ICES1) : 0) |
+                     (Config_Ptr->timer1_clock);
+            break;
+    }
+}
+
+void Timer1_setCallBack(void(*a_ptr)(void), Timer1_EventType event)
+{
+    if(event >= TIMER1_EVENT_COUNT)
+    {
+        return;
+    }
+    g_timer1CallbackPtr[event] = a_ptr;
+    if(a_ptr != NULL_PTR)
+    {
+        SET_BIT(TIMSK, g_timer1InterruptBit[event]);
+    }
+    else
+    {
+        CLEAR_BIT(TIMSK, g_timer1InterruptBit[event]);
+    }
+}
+
+void Timer1_setCompareA(uint16 value)
+{
+    uint8 sreg = SREG;
+
+    /* 16-bit registers go through the shared TEMP register, keep the ISRs out */
+    cli();
+    OCR1A = value;
+    SREG = sreg;
+}
+
+void Timer1_setCompareB(uint16 value)
+{
+    uint8 sreg = SREG;
+
+    cli();
+    OCR1B = value;
+    SREG = sreg;
+}
+
+uint16 Timer1_getCapture(void)
+{
+    uint16 capture;
+    uint8 sreg = SREG;
+
+    cli();
+    capture = g_timer1Capture;
+    SREG = sreg;
+
+    return capture;
+}
+
+void Timer_startTick(void)
+{
+    g_tickCount = 0;
+    g_seconds = 0;
+    g_secondTicks = 0;
+    g_tickRunning = TRUE;
+
+    /* CTC mode with F_CPU/64 clock (CS22 alone selects /64 for Timer2) */
+    TCNT2 = 0;
+    OCR2 = TIMER_TICK_COMPARE_VALUE;
+    TCCR2 = (1<<WGM21) | (1<<CS22);
+    SET_BIT(TIMSK, OCIE2);
+}
+
+uint16 Timer_getTicks(void)
+{
+    return (uint16)Timer_getMillis();
+}
+
+uint32 Timer_getMillis(void)
+{
+    uint32 ticks;
+    uint8 sreg = SREG;
+
+    /* The 32-bit counter is updated by the ISR, read it with the interrupts disabled */
+    cli();
+    ticks = g_tickCount;
+    SREG = sreg;
+
+    return ticks;
+}
+
+uint32 Timer_getMicros(void)
+{
+    uint32 ticks;
+    uint8 counts;
+    uint8 sreg = SREG;
+
+    cli();
+    ticks = g_tickCount;
+    counts = TCNT2;
+    /*
+     * A compare match that happened with the interrupts disabled isn't in
+     * g_tickCount yet. TCNT2 may have been read just before or after the
+     * counter was cleared, read it again now that it surely restarted.
+     */
+    if (BIT_IS_SET(TIFR, OCF2) && g_tickRunning)
+    {
+        counts = TCNT2;
+        ticks++;
+    }
+    SREG = sreg;
+
+#if (1000UL % TIMER_TICK_COUNTS) == 0
+    return (ticks * 1000UL) + ((uint16)counts * (uint16)(1000UL / TIMER_TICK_COUNTS));
+#else
+    return (ticks * 1000UL) + (((uint32)counts * 1000UL) / TIMER_TICK_COUNTS);
+#endif
+}
+
+uint32 Timer_elapsedMicros(uint32 since)
+{
+    return Timer_getMicros() - since;
+}
+
+uint32 Timer_getSeconds(void)
+{
+    uint32 seconds;
+    uint8 sreg = SREG;
+
+    cli();
+    seconds = g_seconds;
+    SREG = sreg;
+
+    return seconds;
+}
+
+boolean Timer_isExpired(uint16 deadline)
+{
+    return ((sint16)(Timer_getTicks() - deadline) >= 0);
+}
+
+boolean Timer_isExpiredMicros(uint32 deadline)
+{
+    return ((sint32)(Timer_getMicros() - deadline) >= 0);
+}
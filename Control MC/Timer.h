@@ -10,6 +10,61 @@
 #define TIMER1_ID  1
 #define TIMER2_ID  2
 
+/*
+ * Timer2 is dedicated to the 1 ms system tick used for timeouts:
+ * CTC mode with F_CPU/64 clock, compare value computed at compile time.
+ */
+#define TIMER_TICK_PRESCALER     64UL
+#define TIMER_TICK_COMPARE_VALUE ((F_CPU / TIMER_TICK_PRESCALER / 1000UL) - 1)
+
+#if (TIMER_TICK_COMPARE_VALUE > 255) || (TIMER_TICK_COMPARE_VALUE < 1)
+#error "The 1 ms system tick can't be generated by Timer2 at this F_CPU"
+#endif
+
+/* Timer2 counts per tick, the sub-millisecond part of Timer_getMicros comes from TCNT2 */
+#define TIMER_TICK_COUNTS        (TIMER_TICK_COMPARE_VALUE + 1)
+
+/*
+ * Timer1 period in microseconds (CTC and Fast PWM modes), override with
+ * -DTIMER1_PERIOD_US=1000UL. The smallest prescaler fitting the period in
+ * 16 bits is picked for the best resolution, and the counts are rounded to
+ * the nearest one. Use TIMER1_CLOCK and TIMER1_TOP_VALUE in Timer1_ConfigType.
+ */
+#ifndef TIMER1_PERIOD_US
+#define TIMER1_PERIOD_US         20000UL
+#endif
+
+/* Timer1 counts in US microseconds at a given prescaler (64-bit math, folded at compile time) */
+#define TIMER1_COUNTS(US, PRESCALER) \
+    (((1ULL * (F_CPU) * (US)) + (500000ULL * (PRESCALER))) / (1000000ULL * (PRESCALER)))
+
+#if TIMER1_COUNTS(TIMER1_PERIOD_US, 1) <= 65536
+#define TIMER1_PRESCALER_VALUE   1
+#define TIMER1_CLOCK             TIMER_PRESCALE_1
+#elif TIMER1_COUNTS(TIMER1_PERIOD_US, 8) <= 65536
+#define TIMER1_PRESCALER_VALUE   8
+#define TIMER1_CLOCK             TIMER_PRESCALE_8
+#elif TIMER1_COUNTS(TIMER1_PERIOD_US, 64) <= 65536
+#define TIMER1_PRESCALER_VALUE   64
+#define TIMER1_CLOCK             TIMER_PRESCALE_64
+#elif TIMER1_COUNTS(TIMER1_PERIOD_US, 256) <= 65536
+#define TIMER1_PRESCALER_VALUE   256
+#define TIMER1_CLOCK             TIMER_PRESCALE_256
+#elif TIMER1_COUNTS(TIMER1_PERIOD_US, 1024) <= 65536
+#define TIMER1_PRESCALER_VALUE   1024
+#define TIMER1_CLOCK             TIMER_PRESCALE_1024
+#else
+#error "TIMER1_PERIOD_US is too long for Timer1 at this F_CPU"
+#endif
+
+#if defined(TIMER1_PRESCALER_VALUE) && (TIMER1_COUNTS(TIMER1_PERIOD_US, TIMER1_PRESCALER_VALUE) < 2)
+#error "TIMER1_PERIOD_US is too short for Timer1 at this F_CPU"
+#endif
+
+/* TOP register value giving TIMER1_PERIOD_US, and a duration as counts at the selected prescaler */
+#define TIMER1_TOP_VALUE         ((uint16)(TIMER1_COUNTS(TIMER1_PERIOD_US, TIMER1_PRESCALER_VALUE) - 1))
+#define TIMER1_US_TO_COUNTS(US)  ((uint16)TIMER1_COUNTS(US, TIMER1_PRESCALER_VALUE))
+
 /*******************************************************************************
  *                               Types Declaration                             *
  *******************************************************************************/
@@ -31,6 +86,30 @@ typedef struct {
     Timer_ModeType timer_mode;
 } Timer_ConfigType;
 
+typedef enum {
+    TIMER1_CTC_MODE,           /* Period set by OCR1A, OCR1B is an extra compare point within it */
+    TIMER1_FAST_PWM_MODE,      /* Period set by ICR1, OC1A (PD5) and OC1B (PD4) non-inverting outputs */
+    TIMER1_INPUT_CAPTURE_MODE  /* Free running, TCNT1 is latched in ICR1 on the ICP1 (PD6) edge */
+} Timer1_ModeType;
+
+typedef enum {
+    TIMER1_EVENT_COMPARE_A, TIMER1_EVENT_COMPARE_B, TIMER1_EVENT_CAPTURE,
+    TIMER1_EVENT_OVERFLOW, TIMER1_EVENT_COUNT
+} Timer1_EventType;
+
+typedef enum {
+    TIMER1_FALLING_EDGE, TIMER1_RISING_EDGE
+} Timer1_EdgeType;
+
+typedef struct {
+    Timer1_ModeType timer1_mode;
+    Timer_ClockType timer1_clock;   /* TIMER1_CLOCK for TIMER1_PERIOD_US */
+    uint16 timer1_top;              /* CTC: OCR1A, Fast PWM: ICR1 (TIMER1_TOP_VALUE) */
+    uint16 timer1_compareA;         /* Fast PWM: OC1A duty, unused otherwise */
+    uint16 timer1_compareB;         /* CTC: OCR1B compare point, Fast PWM: OC1B duty */
+    Timer1_EdgeType timer1_edge;    /* Input capture only */
+} Timer1_ConfigType;
+
 /*******************************************************************************
  *                              Functions Prototypes                           *
  *******************************************************************************/
@@ -52,4 +131,85 @@ void Timer_deInit(uint8 timer_ID);
  * Function to set the Call Back function address for the Timer interrupt.
  */
 void Timer_setCallBack(void(*a_ptr)(void), uint8 timer_ID);
+
+/*
+ * Description :
+ * Initialize Timer1 in one of its Timer1_ModeType modes. No interrupt is
+ * enabled until a callback is set with Timer1_setCallBack.
+ */
+void Timer1_init(const Timer1_ConfigType * Config_Ptr);
+
+/*
+ * Description :
+ * Set the callback of one Timer1 event and enable its interrupt, or
+ * disable it with NULL_PTR.
+ */
+void Timer1_setCallBack(void(*a_ptr)(void), Timer1_EventType event);
+
+/*
+ * Description :
+ * Change OCR1A (CTC period or OC1A duty) or OCR1B at run time.
+ */
+void Timer1_setCompareA(uint16 value);
+void Timer1_setCompareB(uint16 value);
+
+/*
+ * Description :
+ * Return the ICR1 value latched by the last input capture.
+ */
+uint16 Timer1_getCapture(void);
+
+/*
+ * Description :
+ * Start the 1 ms system tick on Timer2.
+ * Timer2 must not be used through Timer_init afterwards.
+ */
+void Timer_startTick(void);
+
+/*
+ * Description :
+ * Return the number of milliseconds since Timer_startTick (wraps every 65.5 s).
+ */
+uint16 Timer_getTicks(void);
+
+/*
+ * Description :
+ * Return the number of milliseconds since Timer_startTick (wraps every 49.7 days).
+ */
+uint32 Timer_getMillis(void);
+
+/*
+ * Description :
+ * Return the number of microseconds since Timer_startTick, the tick count
+ * plus the Timer2 counter read in the same critical section (wraps every
+ * 71.6 min). The resolution is one Timer2 count (8 us at 8 MHz).
+ */
+uint32 Timer_getMicros(void);
+
+/*
+ * Description :
+ * Return the microseconds elapsed since a Timer_getMicros value (wrap safe
+ * for intervals up to 71.6 min).
+ */
+uint32 Timer_elapsedMicros(uint32 since);
+
+/*
+ * Description :
+ * Return TRUE once Timer_getMicros reached the deadline (wrap safe for
+ * deadlines up to 35.7 min in the future).
+ */
+boolean Timer_isExpiredMicros(uint32 deadline);
+
+/*
+ * Description :
+ * Return the number of whole seconds since Timer_startTick.
+ */
+uint32 Timer_getSeconds(void);
+
+/*
+ * Description :
+ * Return TRUE once the tick count reached the deadline (wrap safe for
+ * deadlines up to 32.7 s in the future).
+ */
+boolean Timer_isExpired(uint16 deadline);
 #endif /* TIMER_H_ */
@@ -0,0 +1,324 @@
+#include "UserTable.h"
+#include "CRC.h"
+
+/* RAM index entries, any other value is the fingerprint of a used slot */
+#define USER_INDEX_EMPTY      0x00
+#define USER_INDEX_DELETED    0xFF
+
+/* Records read per EEPROM transaction while building the index */
+#define USER_SCAN_RECORDS     8
+
+#define USER_ID_OFFSET        1
+#define USER_KEY_OFFSET       3
+#define USER_CRC_OFFSET       (USER_RECORD_SIZE - 1)
+
+/* One fingerprint per slot, the index of a used slot is never EMPTY or DELETED */
+static uint8 g_index[USER_TABLE_SLOTS];
+static uint16 g_count = 0;
+
+/* Per-device salt of the keys */
+static uint8 g_salt[HASH_KEY_SIZE];
+static boolean g_hasSalt = FALSE;
+
+/*
+ * Salted hash of the user ID and the PIN.
+ */
+static uint32 UserTable_hash(uint16 user, const uint8 *pin)
+{
+	uint8 message[USER_ID_LENGTH + PASS_LENGTH];
+	uint8 digest[HASH_DIGEST_SIZE];
+	uint8 i;
+
+	message[0] = (uint8)user;
+	message[1] = (uint8)(user >> 8);
+	for (i = 0; i < PASS_LENGTH; ++i)
+	{
+		message[USER_ID_LENGTH + i] = pin[i];
+	}
+	Hash_compute(g_salt, message, sizeof(message), digest);
+	return (uint32)digest[0] | ((uint32)digest[1] << 8) |
+			((uint32)digest[2] << 16) | ((uint32)digest[3] << 24);
+}
+
+/*
+ * Load the salt, or draw and store one if create is TRUE.
+ */
+static boolean UserTable_loadSalt(boolean create)
+{
+	uint8 record[USER_SALT_RECORD_SIZE];
+	uint8 i;
+
+	if ((EEPROM_readBlock(EEPROM_USER_SALT_ADDRESS, record, USER_SALT_RECORD_SIZE) == SUCCESS) &&
+		(record[0] == USER_SALT_MAGIC) &&
+		(CRC8_compute(record, USER_SALT_RECORD_SIZE - 1) == record[USER_SALT_RECORD_SIZE - 1]))
+	{
+		for (i = 0; i < HASH_KEY_SIZE; ++i)
+		{
+			g_salt[i] = record[1 + i];
+		}
+		return TRUE;
+	}
+	if (!create)
+	{
+		return FALSE;
+	}
+
+	if (!Hash_random(&record[1], HASH_KEY_SIZE))
+	{
+		return FALSE;
+	}
+	record[0] = USER_SALT_MAGIC;
+	record[USER_SALT_RECORD_SIZE - 1] = CRC8_compute(record, USER_SALT_RECORD_SIZE - 1);
+	if (EEPROM_writeBlock(EEPROM_USER_SALT_ADDRESS, record, USER_SALT_RECORD_SIZE) == ERROR)
+	{
+		return FALSE;
+	}
+	for (i = 0; i < HASH_KEY_SIZE; ++i)
+	{
+		g_salt[i] = record[1 + i];
+	}
+	return TRUE;
+}
+
+static uint8 UserTable_fingerprint(uint32 key)
+{
+	/* 1..254, never EMPTY or DELETED */
+	return (uint8)(1 + (uint8)(key >> 24) % 254);
+}
+
+static uint16 UserTable_address(uint16 slot)
+{
+	return EEPROM_USER_TABLE_START + slot * USER_RECORD_SIZE;
+}
+
+static uint16 UserTable_getUser(const uint8 *record)
+{
+	return (uint16)record[USER_ID_OFFSET] | ((uint16)record[USER_ID_OFFSET + 1] << 8);
+}
+
+static uint32 UserTable_getKey(const uint8 *record)
+{
+	return (uint32)record[USER_KEY_OFFSET] |
+			((uint32)record[USER_KEY_OFFSET + 1] << 8) |
+			((uint32)record[USER_KEY_OFFSET + 2] << 16) |
+			((uint32)record[USER_KEY_OFFSET + 3] << 24);
+}
+
+static boolean UserTable_isValid(const uint8 *record)
+{
+	return (record[0] == USER_STATE_USED) &&
+			(CRC8_compute(record, USER_CRC_OFFSET) == record[USER_CRC_OFFSET]);
+}
+
+/*
+ * Index entry of a record read from the EEPROM. A damaged record becomes a
+ * tombstone: the slot can be reused but doesn't end the probe sequences.
+ */
+static uint8 UserTable_indexEntry(const uint8 *record)
+{
+	if (UserTable_isValid(record))
+	{
+		return UserTable_fingerprint(UserTable_getKey(record));
+	}
+	if (record[0] == USER_STATE_EMPTY)
+	{
+		return USER_INDEX_EMPTY;
+	}
+	return USER_INDEX_DELETED;
+}
+
+void UserTable_init(void)
+{
+	uint8 records[USER_SCAN_RECORDS * USER_RECORD_SIZE];
+	uint16 slot;
+	uint8 count;
+	uint8 i;
+
+	g_count = 0;
+	g_hasSalt = UserTable_loadSalt(FALSE);
+	for (slot = 0; slot < USER_TABLE_SLOTS; slot += count)
+	{
+		count = ((USER_TABLE_SLOTS - slot) < USER_SCAN_RECORDS) ?
+				(uint8)(USER_TABLE_SLOTS - slot) : USER_SCAN_RECORDS;
+
+		if (EEPROM_readBlock(UserTable_address(slot), records, count * USER_RECORD_SIZE) == ERROR)
+		{
+			/* Unknown content, keep the slots out of use but probe past them */
+			for (i = 0; i < count; ++i)
+			{
+				g_index[slot + i] = USER_INDEX_DELETED;
+			}
+			continue;
+		}
+		for (i = 0; i < count; ++i)
+		{
+			g_index[slot + i] = UserTable_indexEntry(&records[i * USER_RECORD_SIZE]);
+			if ((g_index[slot + i] != USER_INDEX_EMPTY) && (g_index[slot + i] != USER_INDEX_DELETED))
+			{
+				g_count++;
+			}
+		}
+	}
+}
+
+/*
+ * Probe for the record of (user, key). Returns its slot, or USER_TABLE_SLOTS if absent.
+ */
+static uint16 UserTable_find(uint16 user, uint32 key)
+{
+	uint8 record[USER_RECORD_SIZE];
+	uint8 fingerprint = UserTable_fingerprint(key);
+	uint16 slot = (uint16)(key % USER_TABLE_SLOTS);
+	uint16 probe;
+
+	for (probe = 0; probe < USER_TABLE_SLOTS; ++probe)
+	{
+		if (g_index[slot] == USER_INDEX_EMPTY)
+		{
+			break;
+		}
+		if ((g_index[slot] == fingerprint) &&
+			(EEPROM_readBlock(UserTable_address(slot), record, USER_RECORD_SIZE) == SUCCESS) &&
+			UserTable_isValid(record) &&
+			(UserTable_getUser(record) == user) && (UserTable_getKey(record) == key))
+		{
+			return slot;
+		}
+		if (++slot == USER_TABLE_SLOTS)
+		{
+			slot = 0;
+		}
+	}
+	return USER_TABLE_SLOTS;
+}
+
+boolean UserTable_verify(uint16 user, const uint8 *pin)
+{
+	if ((user == USER_ID_ADMIN) || !g_hasSalt)
+	{
+		return FALSE;
+	}
+	return UserTable_find(user, UserTable_hash(user, pin)) != USER_TABLE_SLOTS;
+}
+
+/*
+ * Return the slot of the first record of user at or after slot from, or
+ * USER_TABLE_SLOTS. The slot depends on the PIN, so the user ID can only be
+ * found by a pass over the used slots.
+ */
+static uint16 UserTable_locate(uint16 user, uint16 from)
+{
+	uint8 record[USER_RECORD_SIZE];
+	uint16 slot;
+
+	for (slot = from; slot < USER_TABLE_SLOTS; ++slot)
+	{
+		if ((g_index[slot] != USER_INDEX_EMPTY) && (g_index[slot] != USER_INDEX_DELETED) &&
+			(EEPROM_readBlock(UserTable_address(slot), record, USER_RECORD_SIZE) == SUCCESS) &&
+			UserTable_isValid(record) && (UserTable_getUser(record) == user))
+		{
+			return slot;
+		}
+	}
+	return USER_TABLE_SLOTS;
+}
+
+/*
+ * Tombstone every record of user from slot from on, except the one in slot keep.
+ */
+static boolean UserTable_removeFrom(uint16 user, uint16 from, uint16 keep)
+{
+	uint16 slot;
+	boolean found = FALSE;
+
+	for (slot = UserTable_locate(user, from); slot < USER_TABLE_SLOTS;
+			slot = UserTable_locate(user, slot + 1))
+	{
+		if ((slot != keep) &&
+			(EEPROM_writeByte(UserTable_address(slot), USER_STATE_DELETED) == SUCCESS))
+		{
+			g_index[slot] = USER_INDEX_DELETED;
+			g_count--;
+			found = TRUE;
+		}
+	}
+	return found;
+}
+
+boolean UserTable_remove(uint16 user)
+{
+	return UserTable_removeFrom(user, 0, USER_TABLE_SLOTS);
+}
+
+uint8 UserTable_add(uint16 user, const uint8 *pin)
+{
+	uint8 record[USER_RECORD_SIZE];
+	uint32 key;
+	uint16 slot;
+	uint16 probe;
+	uint16 old;
+
+	if (user == USER_ID_ADMIN)
+	{
+		return ERROR;
+	}
+	/* Replacing a PIN doesn't add a user, it must work with a full table */
+	old = UserTable_locate(user, 0);
+	if ((old == USER_TABLE_SLOTS) && (g_count >= USER_TABLE_MAX_USERS))
+	{
+		return ERROR;
+	}
+
+	/* The salt is drawn with the first user, once the link traffic fed the entropy pool */
+	if (!g_hasSalt)
+	{
+		g_hasSalt = UserTable_loadSalt(TRUE);
+		if (!g_hasSalt)
+		{
+			return ERROR;
+		}
+	}
+
+	key = UserTable_hash(user, pin);
+	slot = (uint16)(key % USER_TABLE_SLOTS);
+	for (probe = 0; probe < USER_TABLE_SLOTS; ++probe)
+	{
+		if ((g_index[slot] == USER_INDEX_EMPTY) || (g_index[slot] == USER_INDEX_DELETED))
+		{
+			break;
+		}
+		if (++slot == USER_TABLE_SLOTS)
+		{
+			slot = 0;
+		}
+	}
+	if (probe == USER_TABLE_SLOTS)
+	{
+		return ERROR;
+	}
+
+	record[0] = USER_STATE_USED;
+	record[USER_ID_OFFSET] = (uint8)user;
+	record[USER_ID_OFFSET + 1] = (uint8)(user >> 8);
+	record[USER_KEY_OFFSET] = (uint8)key;
+	record[USER_KEY_OFFSET + 1] = (uint8)(key >> 8);
+	record[USER_KEY_OFFSET + 2] = (uint8)(key >> 16);
+	record[USER_KEY_OFFSET + 3] = (uint8)(key >> 24);
+	record[USER_CRC_OFFSET] = CRC8_compute(record, USER_CRC_OFFSET);
+
+	/* The record never crosses a page: one page write. The old PIN stays valid if it fails */
+	if (EEPROM_writeBlock(UserTable_address(slot), record, USER_RECORD_SIZE) == ERROR)
+	{
+		g_index[slot] = USER_INDEX_DELETED;
+		return ERROR;
+	}
+	g_index[slot] = UserTable_fingerprint(key);
+	g_count++;
+
+	/* Only now retire the old record(s) of the user */
+	if (old != USER_TABLE_SLOTS)
+	{
+		UserTable_removeFrom(user, old, slot);
+	}
+	return SUCCESS;
+}
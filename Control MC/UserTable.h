@@ -0,0 +1,80 @@
+#ifndef USERTABLE_H_
+#define USERTABLE_H_
+
+#include "std_types.h"
+#include "Frame.h"
+#include "EEPROM.h"
+#include "Hash.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Hash table of user PINs in the EEPROM, open addressing with linear probing.
+ * The key is the HalfSipHash-2-4 of the user ID and the PIN keyed with a
+ * random per-device salt, the PIN itself is not stored. Record (two per EEPROM page):
+ *
+ *   | STATE | USER ID (2 bytes, LSB first) | KEY (4 bytes, LSB first) | CRC-8 |
+ *
+ * A RAM index holds one fingerprint byte of the key per slot, a lookup only
+ * reads the records whose fingerprint matches, so a check costs one EEPROM
+ * read (two on a rare fingerprint collision) whatever the number of users.
+ */
+#define USER_RECORD_SIZE        8
+#define USER_STATE_EMPTY        0xFF    /* Erased EEPROM */
+#define USER_STATE_USED         0xA5
+#define USER_STATE_DELETED      0x00
+
+/*
+ * Salt record, written when the first user is added:
+ *   | MAGIC | SALT (HASH_KEY_SIZE bytes) | CRC-8 |
+ */
+#define USER_SALT_MAGIC         0x5A
+#define USER_SALT_RECORD_SIZE   (HASH_KEY_SIZE + 2)
+
+/* Slots in the table, overridable for host benchmarks with a bigger stub EEPROM */
+#ifndef USER_TABLE_SLOTS
+#define USER_TABLE_SLOTS        (EEPROM_USER_TABLE_SIZE / USER_RECORD_SIZE)
+#endif
+
+/* The table is kept at most 3/4 full so probe sequences stay short */
+#define USER_TABLE_MAX_USERS    ((USER_TABLE_SLOTS * 3UL) / 4UL)
+
+#if (EEPROM_PAGE_SIZE % USER_RECORD_SIZE) != 0
+#error "A user record must not cross an EEPROM page"
+#endif
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Build the RAM index with one sequential pass over the table. Called once at boot.
+ */
+void UserTable_init(void);
+
+/*
+ * Description :
+ * Add a user, or replace the PIN of an existing one. The new record is
+ * written before the old one is deleted, so a failed write keeps the old PIN
+ * and a replacement succeeds with a full table. The admin (USER_ID_ADMIN)
+ * uses the credential store instead and is rejected.
+ * Returns SUCCESS, or ERROR if the table is full or the EEPROM write failed.
+ */
+uint8 UserTable_add(uint16 user, const uint8 *pin);
+
+/*
+ * Description :
+ * Remove a user. Returns TRUE if it was in the table.
+ */
+boolean UserTable_remove(uint16 user);
+
+/*
+ * Description :
+ * Return TRUE if pin (PASS_LENGTH digits) is the PIN of user.
+ */
+boolean UserTable_verify(uint16 user, const uint8 *pin);
+
+#endif /* USERTABLE_H_ */
@@ -0,0 +1,30 @@
+#ifndef CRC_H_
+#define CRC_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/* CRC-8 with polynomial x^8 + x^2 + x + 1 (0x07), initial value 0x00 */
+#define CRC8_POLYNOMIAL   0x07
+#define CRC8_INIT         0x00
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Update a running CRC-8 with one more byte using the lookup table in flash.
+ */
+uint8 CRC8_update(uint8 crc, uint8 data);
+
+/*
+ * Description :
+ * Calculate the CRC-8 of a whole buffer.
+ */
+uint8 CRC8_compute(const uint8 *data, uint8 length);
+
+#endif /* CRC_H_ */
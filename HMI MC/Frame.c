@@ -0,0 +1,106 @@
+#include "Frame.h"
+#include "CRC.h"
+
+void Frame_parserInit(Frame_ParserType *parser)
+{
+	parser->state = FRAME_WAIT_SYNC;
+	parser->index = 0;
+	parser->crc = CRC8_INIT;
+}
+
+Frame_StatusType Frame_parseByte(Frame_ParserType *parser, uint8 data)
+{
+	switch (parser->state)
+	{
+	case FRAME_WAIT_SYNC:
+		if (data == FRAME_SYNC)
+		{
+			parser->crc = CRC8_INIT;
+			parser->state = FRAME_WAIT_TYPE;
+		}
+		break;
+	case FRAME_WAIT_TYPE:
+		parser->frame.type = data;
+		parser->crc = CRC8_update(parser->crc, data);
+		parser->state = FRAME_WAIT_SEQUENCE;
+		break;
+	case FRAME_WAIT_SEQUENCE:
+		parser->frame.sequence = data;
+		parser->crc = CRC8_update(parser->crc, data);
+		parser->state = FRAME_WAIT_LENGTH;
+		break;
+	case FRAME_WAIT_LENGTH:
+		if (data > FRAME_MAX_PAYLOAD)
+		{
+			/* Can't be a valid frame, hunt for the next SYNC */
+			parser->state = FRAME_WAIT_SYNC;
+			return FRAME_CRC_ERROR;
+		}
+		parser->frame.length = data;
+		parser->crc = CRC8_update(parser->crc, data);
+		parser->index = 0;
+		parser->state = (parser->frame.length == 0) ? FRAME_WAIT_CRC : FRAME_WAIT_PAYLOAD;
+		break;
+	case FRAME_WAIT_PAYLOAD:
+		parser->frame.payload[parser->index++] = data;
+		parser->crc = CRC8_update(parser->crc, data);
+		if (parser->index == parser->frame.length)
+		{
+			parser->state = FRAME_WAIT_CRC;
+		}
+		break;
+	case FRAME_WAIT_CRC:
+		parser->state = FRAME_WAIT_SYNC;
+		return (data == parser->crc) ? FRAME_COMPLETE : FRAME_CRC_ERROR;
+	}
+	return FRAME_INCOMPLETE;
+}
+
+Frame_StatusType Frame_parseBlock(Frame_ParserType *parser, uint8 length)
+{
+	uint8 i;
+
+	if ((parser->state != FRAME_WAIT_LENGTH) || (length > FRAME_MAX_PAYLOAD))
+	{
+		parser->state = FRAME_WAIT_SYNC;
+		return FRAME_CRC_ERROR;
+	}
+	parser->frame.length = length;
+	parser->crc = CRC8_update(parser->crc, length);
+	for (i = 0; i < length; ++i)
+	{
+		parser->crc = CRC8_update(parser->crc, parser->frame.payload[i]);
+	}
+	parser->state = FRAME_WAIT_CRC;
+	return FRAME_INCOMPLETE;
+}
+
+uint8 Frame_encode(uint8 *buffer, uint8 type, uint8 sequence,
+		const uint8 *payload, uint8 length)
+{
+	uint8 i;
+	uint8 crc = CRC8_INIT;
+
+	if (length > FRAME_MAX_PAYLOAD)
+	{
+		return 0;
+	}
+
+	buffer[0] = FRAME_SYNC;
+	buffer[1] = type;
+	buffer[2] = sequence;
+	buffer[FRAME_LENGTH_OFFSET] = length;
+	for (i = 0; i < length; ++i)
+	{
+		buffer[FRAME_HEADER_SIZE + i] = payload[i];
+	}
+
+	/* CRC over type, sequence, length and payload */
+	for (i = 1; i < FRAME_HEADER_SIZE + length; ++i)
+	{
+		crc = CRC8_update(crc, buffer[i]);
+	}
+	buffer[FRAME_HEADER_SIZE + length] = crc;
+
+	return FRAME_HEADER_SIZE + length + 1;
+}
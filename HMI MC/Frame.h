@@ -0,0 +1,177 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Frame layout on the wire:
+ *
+ *   | SYNC | TYPE | SEQUENCE | LENGTH | PAYLOAD (LENGTH bytes) | CRC-8 |
+ *
+ * The CRC covers everything from TYPE up to the end of the payload.
+ * LENGTH and PAYLOAD form a length prefixed block, moved through the UART
+ * rings in one go by UART_sendBuffer / UART_receiveBuffer.
+ */
+#define FRAME_SYNC             0x7E
+#define FRAME_MAX_PAYLOAD      32
+#define FRAME_HEADER_SIZE      4
+#define FRAME_LENGTH_OFFSET    (FRAME_HEADER_SIZE - 1)
+#define FRAME_MAX_SIZE         (FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD + 1)
+
+/*
+ * The sequence byte carries a 7-bit sequence number, the MSB asks the
+ * receiver to answer with a LINK_ACK frame once the frame is delivered.
+ */
+#define FRAME_SEQUENCE_MASK    0x7F
+#define FRAME_ACK_REQUEST      0x80
+
+/* Frame types exchanged between the HMI and Control ECUs */
+#define PASS_LOAD        0xA0    // Command: Load new password (password + confirmation)
+#define PASS_IN          0xF1    // Command: Verify a password, optional user ID first (no password: streamed digits follow)
+#define PASS_UPDATE      0xE0    // Command: Verify existing password before an update (same as PASS_IN)
+#define PASS_NEW         0xE1    // Command: New password (password + confirmation) after PASS_UPDATE
+#define USER_ADD         0xE2    // Command: User ID + PIN + confirmation, after an admin PASS_UPDATE
+#define PASS_CORRECT     0xC0    // Response: Password verified successfully
+#define PASS_FAIL        0xF0    // Response: Password verification failed
+#define PEOPLE_IN        0xB0    // Response: People detected entering
+#define PEOPLE_NO        0xD0    // Response: No people detected
+#define ALARM_ON         0xF2    // Command: Activate alarm
+#define DOOR_CLOSED      0xF3    // Response: Door closed
+#define PASS_DIGIT       0xF4    // Command: One streamed password digit
+#define PASS_END         0xF5    // Command: End of streamed password, verdict expected
+#define DOOR_BUSY        0xF6    // Response: Password verified but the door is still cycling, not opened
+#define LINK_ACK         0x80    // Link: Frame delivered, payload is the acknowledged sequence number
+#define BAUD_CAPS        0x90    // Command: Supported baud rates mask (UART_SUPPORTED_RATES)
+#define BAUD_SELECT      0x91    // Response: Selected rate (UART_RateType), both sides switch to it
+#define LOG_DUMP         0xA1    // Command: Stream the audit log from the record offset (2 bytes) on
+#define LOG_DATA         0xA2    // Response: Record offset (2 bytes) of the audit log records that follow
+#define LOG_END          0xA3    // Response: End of the dump, payload is the number of records sent (2 bytes)
+#define QUERY_PROVISIONED 0xA4   // Command: Ask whether Control already holds a password (sent at boot)
+#define PROVISIONED_STATE 0xA5   // Response: PROVISIONED_* flags (1 byte)
+#define CONFIG_GET       0xA6    // Command: Read the settings
+#define CONFIG_DATA      0xA7    // Response: Settings (CONFIG_PAYLOAD_LENGTH bytes)
+#define CONFIG_SET       0xA8    // Command: New settings (CONFIG_PAYLOAD_LENGTH bytes) after an admin PASS_UPDATE
+#define POWER_GET        0xA9    // Command: Read and restart the sleep measurement (POWER_STATS builds)
+#define POWER_DATA       0xAA    // Response: Sleep time and window length (POWER_PAYLOAD_LENGTH bytes)
+#define STATUS_GET       0xAB    // Command: Read the state of the Control tasks, answered at any time
+#define STATUS_DATA      0xAC    // Response: Task states (STATUS_PAYLOAD_LENGTH bytes)
+
+/* Password length and the size of a password followed by its confirmation */
+#define PASS_LENGTH      5
+#define PASS_PAIR_LENGTH (2 * PASS_LENGTH)
+
+/* User IDs travel LSB first in front of the password, ID 0 is the admin (legacy password) */
+#define USER_ID_LENGTH   2
+#define USER_ID_ADMIN    0
+
+/* PROVISIONED_STATE flags */
+#define PROVISIONED_PASSWORD 0x01   // A valid admin password is stored, PASS_LOAD is refused
+
+/*
+ * CONFIG_DATA / CONFIG_SET payload:
+ *   | DOOR SECONDS | LOCKOUT SECONDS (2 bytes, LSB first) | MAX ATTEMPTS |
+ */
+#define CONFIG_DOOR_OFFSET      0
+#define CONFIG_LOCKOUT_OFFSET   1
+#define CONFIG_ATTEMPTS_OFFSET  3
+#define CONFIG_PAYLOAD_LENGTH   4
+
+/*
+ * POWER_DATA payload, in microseconds LSB first:
+ *   | SLEEP TIME (4 bytes) | WINDOW LENGTH (4 bytes) |
+ */
+#define POWER_SLEEP_OFFSET      0
+#define POWER_WINDOW_OFFSET     4
+#define POWER_PAYLOAD_LENGTH    8
+
+/*
+ * STATUS_DATA payload:
+ *   | DOOR STATE | ALARM STATE | ACCESS STATE |
+ */
+#define STATUS_DOOR_OFFSET      0
+#define STATUS_ALARM_OFFSET     1
+#define STATUS_ACCESS_OFFSET    2
+#define STATUS_PAYLOAD_LENGTH   3
+
+/* STATUS_DATA states */
+#define STATUS_DOOR_IDLE        0   // Door closed, motor stopped
+#define STATUS_DOOR_OPENING     1
+#define STATUS_DOOR_HOLDING     2   // Open, waiting for the PIR to clear
+#define STATUS_DOOR_CLOSING     3
+#define STATUS_ALARM_SILENT     0
+#define STATUS_ALARM_SOUNDING   1
+#define STATUS_ACCESS_IDLE      0
+#define STATUS_ACCESS_VERIFYING 1   // PASS_IN / PASS_UPDATE digits being received
+#define STATUS_ACCESS_UPDATE    2   // Admin verified, PASS_NEW / USER_ADD / CONFIG_SET accepted
+
+/* Audit log record offsets travel LSB first */
+#define LOG_OFFSET_LENGTH 2
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+typedef struct {
+    uint8 type;
+    uint8 length;
+    uint8 sequence;
+    uint8 payload[FRAME_MAX_PAYLOAD];
+} Frame_Type;
+
+typedef enum {
+    FRAME_WAIT_SYNC, FRAME_WAIT_TYPE, FRAME_WAIT_SEQUENCE, FRAME_WAIT_LENGTH,
+    FRAME_WAIT_PAYLOAD, FRAME_WAIT_CRC
+} Frame_ParserStateType;
+
+typedef enum {
+    FRAME_INCOMPLETE, FRAME_COMPLETE, FRAME_CRC_ERROR
+} Frame_StatusType;
+
+/* Streaming parser, fed one received byte at a time */
+typedef struct {
+    Frame_ParserStateType state;
+    uint8 index;
+    uint8 crc;
+    Frame_Type frame;
+} Frame_ParserType;
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Reset the parser so it starts hunting for the next SYNC byte.
+ */
+void Frame_parserInit(Frame_ParserType *parser);
+
+/*
+ * Description :
+ * Feed one received byte to the parser.
+ * Returns FRAME_COMPLETE when parser->frame holds a new valid frame,
+ * FRAME_CRC_ERROR when a frame was dropped and FRAME_INCOMPLETE otherwise.
+ */
+Frame_StatusType Frame_parseByte(Frame_ParserType *parser, uint8 data);
+
+/*
+ * Description :
+ * Feed the LENGTH byte and the payload at once, when the parser waits for
+ * LENGTH (the payload is already in parser->frame.payload, e.g. copied there
+ * by UART_receiveBuffer). The CRC byte is then fed with Frame_parseByte.
+ * Returns FRAME_CRC_ERROR if the length is invalid, FRAME_INCOMPLETE otherwise.
+ */
+Frame_StatusType Frame_parseBlock(Frame_ParserType *parser, uint8 length);
+
+/*
+ * Description :
+ * Build a complete frame in buffer (at least FRAME_MAX_SIZE bytes).
+ * Returns the number of bytes to transmit, 0 if the payload is too long.
+ */
+uint8 Frame_encode(uint8 *buffer, uint8 type, uint8 sequence,
+		const uint8 *payload, uint8 length);
+
+#endif /* FRAME_H_ */
@@ -1,35 +1,69 @@
 #include "GPIO.h"
 #include "UART.h"
+#include "Link.h"
 #include "Timer.h"
+#include "SoftTimer.h"
 #include "LCD.h"
 #include "Keypad.h"
-#include "util/delay.h"
+#include "Power.h"
 #include "avr/io.h"
 
-/* Status */
-#define PASS_LOAD        0xA0
-#define PASS_IN          0xF1
-#define PASS_UPDATE      0xE0
-#define PASS_CORRECT     0xC0
-#define PASS_FAIL        0xF0
-#define PEOPLE_IN        0xB0
-#define PEOPLE_NO        0xD0
-#define ALARM_ON         0xF2
-#define DOOR_CLOSED      0xF3
+#define NO_RESPONSE        0x00    /* Receive_Response timed out */
+#define PEOPLE_TIMEOUT_MS  2000    /* Twice the PEOPLE_IN keep-alive period of the Control ECU */
+#define USER_ID_DIGITS     4       /* User IDs 1..9999, none for the admin */
+
+/* Settings used until Control answers CONFIG_GET */
+#define DEFAULT_DOOR_SECONDS     15
+#define DEFAULT_LOCKOUT_SECONDS  60
+#define DEFAULT_MAX_ATTEMPTS     3
+
+/* How long a status message stays on the LCD */
+#define MESSAGE_MS               2000
+
+/* ON/C key: show the time both ECUs spent asleep (POWER_STATS builds) */
+#define POWER_KEY                13
 
 /* Password */
 uint8 password[10] = { 0 };
 uint8 initialPass = 0;
 uint8 keyPressed = 0;
-uint8 timerCount = 0;
 uint8 incorrect = 0;
 uint8 updateFailCount = 0;
 uint8 peopleState = 0;
+uint8 provisionState = NO_RESPONSE;
+/* Settings cached from Control (CONFIG_DATA) */
+uint8 doorSeconds = DEFAULT_DOOR_SECONDS;
+uint16 lockoutSeconds = DEFAULT_LOCKOUT_SECONDS;
+uint8 maxAttempts = DEFAULT_MAX_ATTEMPTS;
 uint8 i = 0;
+uint16 user = USER_ID_ADMIN;
+uint8 userPayload[USER_ID_LENGTH + PASS_PAIR_LENGTH];
+uint8 configPayload[CONFIG_PAYLOAD_LENGTH];
+Frame_Type frame;
+
+void Enter_Pass(uint8 state, uint16 user_id);
+
+uint16 Enter_User(void);
+
+void Enter_NewPass(void);
+
+uint16 Enter_Number(const char *prompt, uint16 current, uint16 max);
+
+void Enter_Settings(void);
+
+uint8 Receive_Response(uint16 timeout_ms);
+
+uint8 Send_Command(uint8 command, const uint8 *payload, uint8 length);
+
+void Reconnect(void);
+
+void Load_Settings(void);
 
-void Enter_Pass(uint8 state);
+void Lock_System(void);
 
-void Timer_Callback(void);
+#ifdef POWER_STATS
+void Show_Power(void);
+#endif
 
 int main() {
 	/* Initialize LCD */
@@ -41,21 +75,28 @@ int main() {
 			UART_1_STOP_BIT,
 			9600 };
 	UART_init(&uart_cfg);
+	Link_init();
 
-	/* Initialize Timer1 */
+	/* 1 ms system tick and the software timers on top of it */
 	SREG |= (1<<7);  // Enable global interrupts
-	Timer_ConfigType time1 = { 0,
-			31250,
-			TIMER1_ID,
-			TIMER_PRESCALE_256,
-			TIMER_COMPARE_MODE };
+	Timer_startTick();
+	SoftTimer_init();
 
-	Timer_init(&time1);
-	Timer_setCallBack(Timer_Callback, TIMER1_ID);
+	/* Start at 9600 baud and switch to the fastest rate both ECUs support */
+	Link_negotiateRate();
+
+	/* Skip the first time setup when Control already holds a password */
+	while ((provisionState = Send_Command(QUERY_PROVISIONED, NULL_PTR, 0)) == NO_RESPONSE) {
+		Reconnect();
+	}
+	if ((provisionState == PROVISIONED_STATE) && (frame.length == 1) &&
+		(frame.payload[0] & PROVISIONED_PASSWORD)) {
+		initialPass = PASS_CORRECT;
+	}
+	Load_Settings();
 
 	/* Prompt user to enter password for the first time */
 	while (initialPass != PASS_CORRECT) {
-		UART_sendByte(PASS_LOAD);
 		LCD_clearScreen();
 		LCD_displayString("Plz Enter Pass:");
 		LCD_moveCursor(1, 0);
@@ -64,11 +105,11 @@ int main() {
 		for (i = 0; i < 5; ++i) {
 			password[i] = KEYPAD_getPressedKey();
 			LCD_displayCharacter('*');
-			_delay_ms(500);
+			SoftTimer_delay(500);
 		}
 
 		while (KEYPAD_getPressedKey() != '=');  // Wait for enter keyPressed
-		_delay_ms(500);
+		SoftTimer_delay(500);
 
 		/* Prompt user to re-enter password */
 		LCD_clearScreen();
@@ -78,23 +119,20 @@ int main() {
 		for (i = 5; i < 10; ++i) {
 			password[i] = KEYPAD_getPressedKey();
 			LCD_displayCharacter('*');
-			_delay_ms(500);
+			SoftTimer_delay(500);
 		}
 		while (KEYPAD_getPressedKey() != '=');  // Confirm entry
-		_delay_ms(500);
+		SoftTimer_delay(500);
 
-		/* Transmit password via UART to Control ECU */
-		for (i = 0; i < 10; ++i) {
-			UART_sendByte(password[i]);
-		}
-
-		/* Verify password */
-		initialPass = UART_receiveByte();
+		/* Transmit password and confirmation to Control ECU in one frame and get the verdict */
+		initialPass = Send_Command(PASS_LOAD, password, PASS_PAIR_LENGTH);
 		if (initialPass == PASS_FAIL) {
 			LCD_clearScreen();
 			LCD_displayString("Mismatch!!");
-			timerCount = 0;
-			while (timerCount < 1);  // Delay before retry
+			SoftTimer_delay(MESSAGE_MS);  // Delay before retry
+		}
+		else if (initialPass == NO_RESPONSE) {
+			Reconnect();
 		}
 	}
 
@@ -102,131 +140,140 @@ int main() {
 	while (1) {
 		/* Display main menu options */
 		LCD_clearScreen();
-		LCD_displayString("+ : OPEN DOOR");
-		LCD_displayStringRowColumn(1, 0, "- : CHANGE PASS");
-
-		while (keyPressed != '+' && keyPressed != '-'){
+		LCD_displayString("+:OPEN  %:CONFIG");
+		LCD_displayStringRowColumn(1, 0, "-:PASS  *:USER");
+
+		while (keyPressed != '+' && keyPressed != '-' && keyPressed != '*' && keyPressed != '%'
+#ifdef POWER_STATS
+				&& keyPressed != POWER_KEY
+#endif
+				){
 			keyPressed = KEYPAD_getPressedKey();
 		}
 
-		_delay_ms(500);
+		SoftTimer_delay(500);
 
 		/* Process user choice */
 		if (keyPressed == '+') {   // open door
-			Enter_Pass(PASS_IN);
+			user = Enter_User();
+			Enter_Pass(PASS_IN, user);
 
 			if (initialPass == PASS_CORRECT) {
 				incorrect = 0;
 				LCD_clearScreen();
 				LCD_displayStringRowColumn(0, 1, "Door Unlocking");
 				LCD_displayStringRowColumn(1, 3, "Please Wait");
-				timerCount = 0;
-				while (timerCount < 5);  // Allow 15 seconds for entry
-				_delay_ms(500);
+				SoftTimer_delay((uint32)doorSeconds * 1000);  // Allow time for entry
+				SoftTimer_delay(500);
 
 				/* Check for people entering */
-				peopleState = UART_receiveByte();
+				peopleState = Receive_Response(PEOPLE_TIMEOUT_MS);
 				LCD_clearScreen();
 				if (peopleState == PEOPLE_IN) {
 					LCD_displayStringRowColumn(0, 0, "Wait for People");
 					LCD_displayStringRowColumn(1, 3, "to Enter");
 				}
-				peopleState = UART_receiveByte();
+				/* PEOPLE_IN is repeated as a keep-alive while people keep entering */
+				while (peopleState == PEOPLE_IN) {
+					peopleState = Receive_Response(PEOPLE_TIMEOUT_MS);
+				}
 				if (peopleState == PEOPLE_NO) {
 					LCD_clearScreen();
 					LCD_displayStringRowColumn(0, 2, "Door Locking");
-					timerCount = 0;
-					while (timerCount < 5);  // Allow time for people to exit
+					SoftTimer_delay((uint32)doorSeconds * 1000);  // Allow time for people to exit
+					peopleState = Receive_Response(PEOPLE_TIMEOUT_MS);
+				}
+				if (peopleState != DOOR_CLOSED) {
+					Reconnect();
 				}
-				peopleState = UART_receiveByte();
 			}
 			else if (initialPass == PASS_FAIL) {
 				++incorrect;
-				if (incorrect == 3) {
-					/* Lock system for 1 minute */
-					UART_sendByte(ALARM_ON);
-					LCD_clearScreen();
-					LCD_displayStringRowColumn(0, 1, "System LOCKED");
-					LCD_displayStringRowColumn(1, 0, "Wait for 1 min.");
-					timerCount = 0;
-					while (timerCount < 20);  // 1-minute delay
+				if (incorrect >= maxAttempts) {
+					Lock_System();
 					incorrect = 0;
 				}
 				else {
 					/* Incorrect password */
 					LCD_clearScreen();
 					LCD_displayString("Incorrect..");
-					timerCount = 0;
-					while (timerCount < 1);
+					SoftTimer_delay(MESSAGE_MS);
 				}
 			}
+			else if (initialPass == DOOR_BUSY) {
+				/* Right password, the door is still closing: not counted as an attempt */
+				LCD_clearScreen();
+				LCD_displayString("Door Busy..");
+				SoftTimer_delay(MESSAGE_MS);
+			}
+			else {
+				Reconnect();
+			}
+			keyPressed = 0;
+		}
+#ifdef POWER_STATS
+		else if (keyPressed == POWER_KEY) {
+			Show_Power();
 			keyPressed = 0;
 		}
-		else if (keyPressed == '-'){  // Change Password
-			Enter_Pass(PASS_UPDATE);
+#endif
+		else {  // Change Password / Add User / Settings, admin only
+			Enter_Pass(PASS_UPDATE, USER_ID_ADMIN);
 
 			if (initialPass == PASS_CORRECT) {
 				updateFailCount = 0;
-				LCD_clearScreen();
-				LCD_displayString("Plz Enter New ");
-				LCD_moveCursor(1, 0);
-				LCD_displayString("Pass: ");
-
-				/* Enter new password */
-				for (i = 0; i < 5; ++i) {
-					password[i] = KEYPAD_getPressedKey();
-					LCD_displayCharacter('*');
-					_delay_ms(500);
+				SoftTimer_delay(500);  // Let the '=' key go before reading the new password
+
+				if (keyPressed == '-') {
+					/* Transmit new password and confirmation, then get the verdict */
+					Enter_NewPass();
+					initialPass = Send_Command(PASS_NEW, password, PASS_PAIR_LENGTH);
 				}
-				while (KEYPAD_getPressedKey() != '=');
-				_delay_ms(500);
-				LCD_clearScreen();
-				LCD_displayString("Plz re-enter the");
-				LCD_displayStringRowColumn(1, 0, "same pass: ");
-
-				/* Re-enter new password for confirmation */
-				for (i = 5; i < 10; ++i) {
-					password[i] = KEYPAD_getPressedKey();
-					LCD_displayCharacter('*');
-					_delay_ms(500);
+				else if (keyPressed == '*') {
+					/* User ID, then its PIN and confirmation in one frame */
+					user = Enter_User();
+					Enter_NewPass();
+					userPayload[0] = (uint8)user;
+					userPayload[1] = (uint8)(user >> 8);
+					for (i = 0; i < PASS_PAIR_LENGTH; ++i) {
+						userPayload[USER_ID_LENGTH + i] = password[i];
+					}
+					initialPass = Send_Command(USER_ADD, userPayload, USER_ID_LENGTH + PASS_PAIR_LENGTH);
 				}
-				while (KEYPAD_getPressedKey() != '=');
-				_delay_ms(500);
-
-				/* Transmit new password */
-				for (i = 0; i < 10; ++i) {
-					UART_sendByte(password[i]);
+				else {
+					/* Door time, lockout time and attempts in one frame */
+					Enter_Settings();
+					initialPass = Send_Command(CONFIG_SET, configPayload, CONFIG_PAYLOAD_LENGTH);
+					if (initialPass == PASS_CORRECT) {
+						Load_Settings();
+					}
 				}
-
-				/* Confirm new password */
-				initialPass = UART_receiveByte();
 				if (initialPass == PASS_FAIL) {
 					LCD_clearScreen();
-					LCD_displayString("Mismatch!!");
-					timerCount = 0;
-					while (timerCount < 1);
+					LCD_displayString((keyPressed == '-') ? "Mismatch!!" :
+							((keyPressed == '*') ? "User Not Added" : "Not Saved"));
+					SoftTimer_delay(MESSAGE_MS);
+				}
+				else if (initialPass == NO_RESPONSE) {
+					Reconnect();
 				}
 			}
 			else if (initialPass == PASS_FAIL) {
 				++updateFailCount;
-				if (updateFailCount == 3) {
-					/* Lock system for 1 minute */
-					UART_sendByte(ALARM_ON);
-					LCD_clearScreen();
-					LCD_displayStringRowColumn(0, 1, "System LOCKED");
-					LCD_displayStringRowColumn(1, 0, "Wait for 1 min.");
-					timerCount = 0;
-					while (timerCount < 20);
+				if (updateFailCount >= maxAttempts) {
+					Lock_System();
 					updateFailCount = 0;
 				}
 				else {
 					/* Incorrect password */
 					LCD_clearScreen();
 					LCD_displayString("Incorrect..");
-					timerCount = 0;
-					while (timerCount < 1);
+					SoftTimer_delay(MESSAGE_MS);
 				}
 			}
+			else {
+				Reconnect();
+			}
 			keyPressed = 0;
 		}
 	}
@@ -234,31 +281,261 @@ int main() {
 }
 
 
-void Enter_Pass (uint8 state){
-	UART_sendByte(state);
+/*
+ * Read a user ID terminated by '=', an empty ID selects the admin.
+ */
+uint16 Enter_User (void) {
+	uint16 user_id = USER_ID_ADMIN;
+	uint8 digits = 0;
+	uint8 key;
+
+	LCD_clearScreen();
+	LCD_displayString("User ID:");
+	LCD_displayStringRowColumn(1, 0, "(= : admin) ");
+
+	key = KEYPAD_getPressedKey();
+	while (key != '=') {
+		if ((key <= 9) && (digits < USER_ID_DIGITS)) {
+			user_id = user_id * 10 + key;
+			LCD_displayCharacter('0' + key);
+			++digits;
+		}
+		SoftTimer_delay(500);
+		key = KEYPAD_getPressedKey();
+	}
+	SoftTimer_delay(500);
+	return user_id;
+}
+
+/*
+ * Read a new password and its confirmation into password[].
+ */
+void Enter_NewPass (void) {
+	LCD_clearScreen();
+	LCD_displayString("Plz Enter New ");
+	LCD_moveCursor(1, 0);
+	LCD_displayString("Pass: ");
+
+	/* Enter new password */
+	for (i = 0; i < 5; ++i) {
+		password[i] = KEYPAD_getPressedKey();
+		LCD_displayCharacter('*');
+		SoftTimer_delay(500);
+	}
+	while (KEYPAD_getPressedKey() != '=');
+	SoftTimer_delay(500);
+	LCD_clearScreen();
+	LCD_displayString("Plz re-enter the");
+	LCD_displayStringRowColumn(1, 0, "same pass: ");
+
+	/* Re-enter new password for confirmation */
+	for (i = 5; i < 10; ++i) {
+		password[i] = KEYPAD_getPressedKey();
+		LCD_displayCharacter('*');
+		SoftTimer_delay(500);
+	}
+	while (KEYPAD_getPressedKey() != '=');
+	SoftTimer_delay(500);
+}
+
+/*
+ * Read a number up to max terminated by '=', showing the current value.
+ * Digits that would exceed max are ignored, no digit keeps the current value.
+ */
+uint16 Enter_Number (const char *prompt, uint16 current, uint16 max) {
+	uint16 value = 0;
+	uint8 digits = 0;
+	uint8 key;
+
+	LCD_clearScreen();
+	LCD_displayString(prompt);
+	LCD_unsignedToString(current);
+	LCD_moveCursor(1, 0);
+	LCD_displayString("New: ");
+
+	key = KEYPAD_getPressedKey();
+	while (key != '=') {
+		if ((key <= 9) && (((uint32)value * 10 + key) <= max)) {
+			value = value * 10 + key;
+			LCD_displayCharacter('0' + key);
+			++digits;
+		}
+		SoftTimer_delay(500);
+		key = KEYPAD_getPressedKey();
+	}
+	SoftTimer_delay(500);
+	return (digits == 0) ? current : value;
+}
+
+/*
+ * Read the new settings into configPayload[], starting from the cached ones.
+ * Control checks the ranges and answers PASS_FAIL if one is out.
+ */
+void Enter_Settings (void) {
+	uint16 lockout;
+
+	configPayload[CONFIG_DOOR_OFFSET] = (uint8)Enter_Number("Door s: ", doorSeconds, 255);
+	lockout = Enter_Number("Lockout s: ", lockoutSeconds, 9999);
+	configPayload[CONFIG_LOCKOUT_OFFSET] = (uint8)lockout;
+	configPayload[CONFIG_LOCKOUT_OFFSET + 1] = (uint8)(lockout >> 8);
+	configPayload[CONFIG_ATTEMPTS_OFFSET] = (uint8)Enter_Number("Attempts: ", maxAttempts, 9);
+}
+
+void Enter_Pass (uint8 state, uint16 user_id){
+	uint8 id[USER_ID_LENGTH];
+
 	LCD_clearScreen();
 	LCD_displayString("Plz enter old");
 	LCD_displayStringRowColumn(1, 0, "pass: ");
 
+	/*
+	 * Stream the digits as they are typed: the command goes out on the first
+	 * key press so Control fetches the stored password while the user types,
+	 * and compares each digit on arrival
+	 */
 	for (i = 0; i < 5; ++i) {
 		password[i] = KEYPAD_getPressedKey();
+		if (i == 0) {
+			/* The admin is implied when no user ID is sent */
+			id[0] = (uint8)user_id;
+			id[1] = (uint8)(user_id >> 8);
+			if (!Link_sendReliable(state, id, (user_id == USER_ID_ADMIN) ? 0 : USER_ID_LENGTH)) {
+				break;
+			}
+		}
+		if (!Link_sendReliable(PASS_DIGIT, &password[i], 1)) {
+			break;
+		}
 		LCD_displayCharacter('*');
-		_delay_ms(500);
+		SoftTimer_delay(500);
+	}
+	if (i < 5) {
+		/* Link lost: not a wrong password, the caller reconnects without counting a failure */
+		initialPass = NO_RESPONSE;
+		return;
 	}
 	while (KEYPAD_getPressedKey() != '=');
-	_delay_ms(500);
 
-	/* Transmit password */
-	for (i = 0; i < 5; ++i) {
-		UART_sendByte(password[i]);
-		_delay_ms(10);
+	/* The verdict is ready as soon as the end of the password arrives */
+	initialPass = Send_Command(PASS_END, NULL_PTR, 0);
+
+}
+
+/*
+ * Send a command frame, wait for its acknowledgement and then for the verdict.
+ * Returns the verdict frame type or NO_RESPONSE.
+ */
+uint8 Send_Command (uint8 command, const uint8 *payload, uint8 length) {
+	uint8 response = NO_RESPONSE;
+#ifdef LINK_TRACE
+	uint32 startTime = Timer_getMicros();
+#endif
+
+	if (Link_sendReliable(command, payload, length)) {
+		response = Receive_Response(LINK_RESPONSE_TIMEOUT_MS);
 	}
-	_delay_ms(100);
 
-	initialPass = UART_receiveByte();
+#ifdef LINK_TRACE
+	/* Show the ACK round trip in us and the command to verdict latency in ms */
+	startTime = Timer_elapsedMicros(startTime);
+	LCD_clearScreen();
+	LCD_displayString("ACK us: ");
+	LCD_unsignedToString(Link_getRoundTrip());
+	LCD_displayStringRowColumn(1, 0, "Verdict ms: ");
+	LCD_unsignedToString(startTime / 1000);
+	SoftTimer_delay(1000);
+#endif
+	return response;
+}
+
+/*
+ * Wait for the next frame from the Control ECU and return its type,
+ * or NO_RESPONSE if nothing valid arrives within timeout_ms.
+ */
+uint8 Receive_Response (uint16 timeout_ms) {
+	if (!Link_receiveTimeout(&frame, timeout_ms)) {
+		return NO_RESPONSE;
+	}
+	return frame.type;
+}
 
+/*
+ * The Control ECU stopped answering (reset or line noise),
+ * renegotiate the link before going back to the menu.
+ */
+void Reconnect (void) {
+	LCD_clearScreen();
+	LCD_displayString("No Response..");
+	LCD_displayStringRowColumn(1, 0, "Reconnecting");
+	Link_negotiateRate();
+	Load_Settings();
 }
 
-void Timer_Callback (void) {
-	++timerCount;
+/*
+ * Refresh the cached settings, the previous ones are kept if Control doesn't answer.
+ */
+void Load_Settings (void) {
+	if ((Send_Command(CONFIG_GET, NULL_PTR, 0) == CONFIG_DATA) &&
+		(frame.length == CONFIG_PAYLOAD_LENGTH)) {
+		doorSeconds = frame.payload[CONFIG_DOOR_OFFSET];
+		lockoutSeconds = (uint16)frame.payload[CONFIG_LOCKOUT_OFFSET] |
+				((uint16)frame.payload[CONFIG_LOCKOUT_OFFSET + 1] << 8);
+		maxAttempts = frame.payload[CONFIG_ATTEMPTS_OFFSET];
+	}
+}
+
+/*
+ * Too many wrong passwords: sound the alarm on Control and lock the keypad.
+ */
+void Lock_System (void) {
+	Link_sendReliable(ALARM_ON, NULL_PTR, 0);
+	LCD_clearScreen();
+	LCD_displayStringRowColumn(0, 1, "System LOCKED");
+	LCD_displayStringRowColumn(1, 0, "Wait for ");
+	LCD_integerToString(lockoutSeconds);
+	LCD_displayString(" s");
+	SoftTimer_delay((uint32)lockoutSeconds * 1000);
+}
+
+#ifdef POWER_STATS
+/*
+ * Percentage of a stats window spent asleep.
+ */
+static uint8 Sleep_Percent (const Power_StatsType *stats) {
+	if (stats->window_us < 100) {
+		return 0;
+	}
+	return (uint8)(stats->sleep_us / (stats->window_us / 100));
+}
+
+/*
+ * Read the sleep time of both ECUs since the previous report: the HMI's own
+ * counters and POWER_DATA from Control, which restarts its window too.
+ */
+void Show_Power (void) {
+	Power_StatsType hmi;
+	Power_StatsType control;
+
+	Power_takeStats(&hmi);
+	if ((Send_Command(POWER_GET, NULL_PTR, 0) != POWER_DATA) ||
+		(frame.length != POWER_PAYLOAD_LENGTH)) {
+		Reconnect();
+		return;
+	}
+	control.sleep_us = 0;
+	control.window_us = 0;
+	for (i = 0; i < 4; ++i) {
+		control.sleep_us |= (uint32)frame.payload[POWER_SLEEP_OFFSET + i] << (8 * i);
+		control.window_us |= (uint32)frame.payload[POWER_WINDOW_OFFSET + i] << (8 * i);
+	}
+
+	LCD_clearScreen();
+	LCD_displayString("HMI asleep ");
+	LCD_unsignedToString(Sleep_Percent(&hmi));
+	LCD_displayCharacter('%');
+	LCD_displayStringRowColumn(1, 0, "Ctrl asleep ");
+	LCD_unsignedToString(Sleep_Percent(&control));
+	LCD_displayCharacter('%');
+	SoftTimer_delay(MESSAGE_MS);
 }
+#endif
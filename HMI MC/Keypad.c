@@ -1,6 +1,6 @@
 #include "Keypad.h"
 #include "GPIO.h"
-#include <util/delay.h>
+#include "Power.h"
 
 /*******************************************************************************
  *                      Functions Prototypes(Private)                          *
@@ -64,7 +64,7 @@ uint8 KEYPAD_getPressedKey(void)
 				}
 			}
 			GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID,KEYPAD_FIRST_ROW_PIN_ID+row,PIN_INPUT);
-			_delay_ms(10); /* Add small delay to fix CPU load issue in proteus */
+			Power_idle(); /* Sleep until the next tick between the rows */
 		}
 	}
 }
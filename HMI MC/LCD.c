@@ -193,6 +193,24 @@ void LCD_integerToString(int data)
    LCD_displayString(buff); /* Display the string */
 }
 
+/*
+ * Description :
+ * Display an unsigned 32-bit decimal value on the screen (e.g. a time in us)
+ */
+void LCD_unsignedToString(uint32 data)
+{
+   char buff[11]; /* Up to 10 digits and the terminator */
+   uint8 i = sizeof(buff) - 1;
+
+   buff[i] = '\0';
+   do
+   {
+      buff[--i] = (char)('0' + (data % 10)); /* Digits are produced from the least significant one */
+      data /= 10;
+   } while(data != 0);
+   LCD_displayString(&buff[i]);
+}
+
 /*
  * Description :
  * Send the clear screen command
@@ -98,6 +98,12 @@ void LCD_displayStringRowColumn(uint8 row,uint8 col,const char *Str);
  */
 void LCD_integerToString(int data);
 
+/*
+ * Description :
+ * Display an unsigned 32-bit decimal value on the screen (e.g. a time in us)
+ */
+void LCD_unsignedToString(uint32 data);
+
 /*
  * Description :
  * Send the clear screen command
@@ -0,0 +1,318 @@
+#include "Link.h"
+#include "UART.h"
+#include "Timer.h"
+#include "Power.h"
+
+static Frame_ParserType g_parser;
+static uint8 g_txSequence = 0;
+static uint8 g_txFrame[FRAME_MAX_SIZE];
+static uint8 g_rxErrors = 0;
+
+/* Sequence number of the last delivered frame that asked for an acknowledgement */
+static uint8 g_lastRxSequence = 0xFF;
+
+/* Frames received while waiting for a LINK_ACK, handed out in order by Link_poll */
+static Frame_Type g_pending[LINK_PENDING_FRAMES];
+static uint8 g_pendingFirst = 0;
+static uint8 g_pendingCount = 0;
+
+/* Microseconds from the last acknowledged transmission to its LINK_ACK */
+static uint32 g_roundTrip = 0;
+
+/*
+ * Return the fastest rate present in the mask (9600 is always present).
+ */
+static uint8 Link_fastestRate(uint8 mask)
+{
+	uint8 rate = UART_RATE_COUNT - 1;
+
+	while ((rate > UART_RATE_9600) && !(mask & (1 << rate)))
+	{
+		rate--;
+	}
+	return rate;
+}
+
+/*
+ * Forget the sequence numbers of both directions, the peer restarts from 0
+ * after a reboot or a rate negotiation.
+ */
+static void Link_resetSequences(void)
+{
+	g_txSequence = 0;
+	g_lastRxSequence = 0xFF;
+}
+
+void Link_init(void)
+{
+	Frame_parserInit(&g_parser);
+	Link_resetSequences();
+	g_rxErrors = 0;
+	g_pendingCount = 0;
+}
+
+/*
+ * Queue bytes, waiting only while the TX buffer is full.
+ */
+static void Link_write(const uint8 *buffer, uint8 size)
+{
+	uint8 sent = 0;
+
+	while (sent < size)
+	{
+		sent += UART_write(&buffer[sent], size - sent);
+	}
+}
+
+/*
+ * Queue a whole encoded frame: the header up to SEQUENCE, then LENGTH and the
+ * payload as one length prefixed block, then the CRC.
+ */
+static void Link_transmit(const uint8 *buffer, uint8 size)
+{
+	if (size == 0)
+	{
+		return;   /* Payload too long, nothing was encoded */
+	}
+	Link_write(buffer, FRAME_LENGTH_OFFSET);
+	UART_sendBuffer(&buffer[FRAME_HEADER_SIZE], buffer[FRAME_LENGTH_OFFSET]);
+	Link_write(&buffer[size - 1], 1);
+}
+
+static void Link_sendAck(uint8 sequence)
+{
+	uint8 ack[FRAME_HEADER_SIZE + 2];
+
+	Link_transmit(ack, Frame_encode(ack, LINK_ACK, 0, &sequence, 1));
+}
+
+/*
+ * Parse the received bytes, returning any complete frame including LINK_ACKs.
+ */
+static boolean Link_pollFrame(Frame_Type *frame)
+{
+	uint8 data;
+	uint8 length;
+	Frame_StatusType status;
+
+	while (UART_tryReceiveByte(&data))
+	{
+		status = Frame_parseByte(&g_parser, data);
+		if (g_parser.state == FRAME_WAIT_LENGTH)
+		{
+			/* Header in, LENGTH and the payload are copied out of the RX ring as one block */
+			if (UART_receiveBuffer(g_parser.frame.payload, FRAME_MAX_PAYLOAD, &length,
+					Timer_getTicks() + LINK_BLOCK_TIMEOUT_MS))
+			{
+				status = Frame_parseBlock(&g_parser, length);
+			}
+			else
+			{
+				Frame_parserInit(&g_parser);
+				status = FRAME_CRC_ERROR;
+			}
+		}
+		if (status == FRAME_COMPLETE)
+		{
+			*frame = g_parser.frame;
+			g_rxErrors = 0;
+			return TRUE;
+		}
+		else if ((status == FRAME_CRC_ERROR) && (g_rxErrors != 0xFF))
+		{
+			g_rxErrors++;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Acknowledge the frame if asked to, returning FALSE for a retransmission
+ * of the last delivered frame.
+ */
+static boolean Link_accept(const Frame_Type *frame)
+{
+	uint8 sequence = frame->sequence & FRAME_SEQUENCE_MASK;
+
+	if (!(frame->sequence & FRAME_ACK_REQUEST))
+	{
+		return TRUE;
+	}
+	Link_sendAck(sequence);
+	if (sequence == g_lastRxSequence)
+	{
+		return FALSE;
+	}
+	g_lastRxSequence = sequence;
+	return TRUE;
+}
+
+void Link_send(uint8 type, const uint8 *payload, uint8 length)
+{
+	Link_transmit(g_txFrame, Frame_encode(g_txFrame, type, g_txSequence, payload, length));
+	g_txSequence = (g_txSequence + 1) & FRAME_SEQUENCE_MASK;
+}
+
+boolean Link_sendReliable(uint8 type, const uint8 *payload, uint8 length)
+{
+	uint8 sequence = g_txSequence;
+	uint8 size;
+	uint8 attempt;
+	uint16 deadline;
+	uint32 sentAt;
+	Frame_Type frame;
+
+	size = Frame_encode(g_txFrame, type, sequence | FRAME_ACK_REQUEST, payload, length);
+	g_txSequence = (g_txSequence + 1) & FRAME_SEQUENCE_MASK;
+
+	for (attempt = 0; attempt <= LINK_MAX_RETRIES; ++attempt)
+	{
+		sentAt = Timer_getMicros();
+		Link_transmit(g_txFrame, size);
+		deadline = Timer_getTicks() + LINK_ACK_TIMEOUT_MS;
+		while (!Timer_isExpired(deadline))
+		{
+			if (!Link_pollFrame(&frame))
+			{
+				/* The next byte or tick wakes the CPU up */
+				Power_idleUnless(UART_isRxPending);
+				continue;
+			}
+			if (frame.type == LINK_ACK)
+			{
+				if ((frame.length == 1) && (frame.payload[0] == sequence))
+				{
+					g_roundTrip = Timer_elapsedMicros(sentAt);
+					return TRUE;
+				}
+			}
+			else if (g_pendingCount < LINK_PENDING_FRAMES)
+			{
+				if (Link_accept(&frame))
+				{
+					/* Keep it for the application */
+					g_pending[(g_pendingFirst + g_pendingCount) % LINK_PENDING_FRAMES] = frame;
+					g_pendingCount++;
+				}
+			}
+			/*
+			 * No room left: the frame is neither acknowledged nor kept,
+			 * the peer sends it again if it asked for a LINK_ACK.
+			 */
+		}
+	}
+	return FALSE;
+}
+
+uint32 Link_getRoundTrip(void)
+{
+	return g_roundTrip;
+}
+
+boolean Link_poll(Frame_Type *frame)
+{
+	if (g_pendingCount != 0)
+	{
+		*frame = g_pending[g_pendingFirst];
+		g_pendingFirst = (g_pendingFirst + 1) % LINK_PENDING_FRAMES;
+		g_pendingCount--;
+		return TRUE;
+	}
+	while (Link_pollFrame(frame))
+	{
+		/* Late acknowledgements have nobody waiting for them */
+		if ((frame->type != LINK_ACK) && Link_accept(frame))
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+void Link_receive(Frame_Type *frame)
+{
+	while (!Link_poll(frame))
+	{
+		Power_idleUnless(UART_isRxPending);
+	}
+}
+
+/*
+ * Wait for a valid frame until the deadline passes, then drop any partial frame.
+ */
+static boolean Link_receiveUntil(Frame_Type *frame, uint16 deadline)
+{
+	while (!Link_poll(frame))
+	{
+		if (Timer_isExpired(deadline))
+		{
+			Frame_parserInit(&g_parser);
+			return FALSE;
+		}
+		Power_idleUnless(UART_isRxPending);
+	}
+	return TRUE;
+}
+
+boolean Link_receiveTimeout(Frame_Type *frame, uint16 ms)
+{
+	return Link_receiveUntil(frame, Timer_getTicks() + ms);
+}
+
+void Link_resync(void)
+{
+	Frame_parserInit(&g_parser);
+	Link_resetSequences();
+}
+
+uint8 Link_takeErrors(void)
+{
+	uint16 errors = (uint16)g_rxErrors + UART_takeErrors();
+
+	g_rxErrors = 0;
+	return (errors > 0xFF) ? 0xFF : (uint8)errors;
+}
+
+void Link_negotiateRate(void)
+{
+	uint8 capabilities = UART_SUPPORTED_RATES;
+	uint16 deadline;
+	Frame_Type frame;
+
+	while (1)
+	{
+		/* Whatever rate was in use before, the peer falls back to 9600 when it sees garbage */
+		UART_setRate(UART_RATE_9600);
+		Link_resetSequences();
+		Link_send(BAUD_CAPS, &capabilities, 1);
+
+		/* Skip stale frames still queued from before, until the answer or the timeout */
+		deadline = Timer_getTicks() + LINK_RESPONSE_TIMEOUT_MS;
+		while (Link_receiveUntil(&frame, deadline))
+		{
+			if ((frame.type == BAUD_SELECT) && (frame.length == 1))
+			{
+				UART_setRate(frame.payload[0]);
+				return;
+			}
+		}
+	}
+}
+
+void Link_acceptRate(const Frame_Type *frame)
+{
+	uint8 rate;
+
+	if (frame->length != 1)
+	{
+		return;
+	}
+	rate = Link_fastestRate(frame->payload[0] & UART_SUPPORTED_RATES);
+
+	/* The peer (re)started its sequence numbers with BAUD_CAPS */
+	Link_resetSequences();
+	Link_send(BAUD_SELECT, &rate, 1);
+
+	/* UART_setRate waits for the answer to leave at the old rate */
+	UART_setRate(rate);
+}
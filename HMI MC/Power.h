@@ -0,0 +1,65 @@
+#ifndef POWER_H_
+#define POWER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Power_idle puts the CPU in IDLE sleep: the clocks of Timer2, the UART and
+ * the TWI keep running and any of their interrupts wakes it up. The 1 ms tick
+ * guarantees a wake-up every millisecond, so polled inputs (keypad, PIR) are
+ * sampled at least that often. A wait for anything else passes its condition
+ * to Power_idleUnless, which checks it with the interrupts off, so an
+ * interrupt landing between the check and the sleep can't delay it until the
+ * next tick. Power-save mode isn't used: Timer2 only runs
+ * there from an external 32 kHz crystal, which would stop the tick.
+ *
+ * Build with POWER_STATS defined to measure the time spent asleep.
+ */
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/* Condition a sleep waits for, called with the interrupts disabled */
+typedef boolean (*Power_PendingType)(void);
+
+#ifdef POWER_STATS
+typedef struct {
+	uint32 sleep_us;   /* Time asleep in Power_idle during the window */
+	uint32 window_us;  /* Length of the window */
+} Power_StatsType;
+#endif
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Sleep until the next interrupt. Returns at once if the interrupts are
+ * disabled, nothing could wake the CPU up.
+ */
+void Power_idle(void);
+
+/*
+ * Description :
+ * Same as Power_idle, unless pending returns TRUE: it is called with the
+ * interrupts disabled right before sleeping, an interrupt making it TRUE
+ * after the check still wakes the CPU up.
+ */
+void Power_idleUnless(Power_PendingType pending);
+
+#ifdef POWER_STATS
+/*
+ * Description :
+ * Copy the sleep time and window length measured since the previous call
+ * (or Timer_startTick) and start a new window.
+ */
+void Power_takeStats(Power_StatsType *stats);
+#endif
+
+#endif /* POWER_H_ */
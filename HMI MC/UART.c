@@ -1,16 +1,117 @@
 #include "UART.h"
 #include "avr/io.h" /* To use the UART Registers */
 #include "common_macros.h" /* To use the macros like SET_BIT */
+#include "Timer.h" /* For the 1 ms tick used by the timeouts */
+#include "Power.h" /* To sleep while waiting for bytes */
+#include <avr/interrupt.h>
+
+#define UART_TX_MASK  (UART_TX_BUFFER_SIZE - 1)
+#define UART_RX_MASK  (UART_RX_BUFFER_SIZE - 1)
+
+/*
+ * Ring buffers shared with the ISRs. The indices are free running, the producer
+ * only writes the head and the consumer only writes the tail so no locking is
+ * needed as long as both stay 8-bit.
+ */
+static volatile uint8 g_txBuffer[UART_TX_BUFFER_SIZE];
+static volatile uint8 g_txHead = 0;
+static volatile uint8 g_txTail = 0;
+static volatile boolean g_txStarted = FALSE;
+
+static volatile uint8 g_rxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint8 g_rxHead = 0;
+static volatile uint8 g_rxTail = 0;
+static volatile uint8 g_rxErrors = 0;
+
+/* Baud rates and their UBRR values, computed at compile time (0 when not usable) */
+static const UART_BaudRateType g_rateBaud[UART_RATE_COUNT] = {
+	9600UL, 19200UL, 38400UL, 57600UL, 76800UL, 115200UL, 250000UL
+};
+
+static const uint16 g_rateUbrr[UART_RATE_COUNT] = {
+	UART_RATE_9600_MASK   ? UART_UBRR_VALUE(9600UL)   : 0,
+	UART_RATE_19200_MASK  ? UART_UBRR_VALUE(19200UL)  : 0,
+	UART_RATE_38400_MASK  ? UART_UBRR_VALUE(38400UL)  : 0,
+	UART_RATE_57600_MASK  ? UART_UBRR_VALUE(57600UL)  : 0,
+	UART_RATE_76800_MASK  ? UART_UBRR_VALUE(76800UL)  : 0,
+	UART_RATE_115200_MASK ? UART_UBRR_VALUE(115200UL) : 0,
+	UART_RATE_250000_MASK ? UART_UBRR_VALUE(250000UL) : 0
+};
+
+/*
+ * Move the received byte from UDR into the RX ring buffer.
+ * If the buffer is full the byte is dropped.
+ */
+static void UART_rxService(void)
+{
+	uint8 head = g_rxHead;
+	uint8 flags = UCSRA; /* Error flags must be read before UDR */
+	uint8 data = UDR;
+
+	if ((flags & ((1 << FE) | (1 << DOR))) && (g_rxErrors != 0xFF))
+	{
+		g_rxErrors++;
+	}
+
+	if ((uint8)(head - g_rxTail) < UART_RX_BUFFER_SIZE)
+	{
+		g_rxBuffer[head & UART_RX_MASK] = data;
+		g_rxHead = head + 1;
+	}
+	else if (g_rxErrors != 0xFF)
+	{
+		g_rxErrors++;
+	}
+}
+
+/*
+ * Move the next queued byte into UDR and disable the UDRE interrupt once the
+ * TX ring buffer runs empty.
+ */
+static void UART_txService(void)
+{
+	uint8 tail = g_txTail;
+
+	if (tail != g_txHead)
+	{
+		/* Clear TXC (write one) so UART_flush can tell when this byte is out */
+		UCSRA = (1 << U2X) | (1 << TXC);
+		UDR = g_txBuffer[tail & UART_TX_MASK];
+		g_txStarted = TRUE;
+		g_txTail = ++tail;
+	}
+	if (tail == g_txHead)
+	{
+		CLEAR_BIT(UCSRB,UDRIE);
+	}
+}
+
+ISR(USART_RXC_vect)
+{
+	UART_rxService();
+}
+
+ISR(USART_UDRE_vect)
+{
+	UART_txService();
+}
 
 void UART_init(const UART_ConfigType * Config_Ptr)
 {
     uint16 ubrr_value = 0;
+    uint8 rate;
 
     /* U2X = 1 for double transmission speed */
     UCSRA = (1 << U2X);
 
-    /* Enable RX and TX, configure UCSZ2 for data size */
-    UCSRB = (1 << RXEN) | (1 << TXEN);
+    /* Flush the ring buffers */
+    g_txHead = g_txTail = 0;
+    g_rxHead = g_rxTail = 0;
+    g_txStarted = FALSE;
+    g_rxErrors = 0;
+
+    /* Enable RX and TX with the receive complete interrupt, configure UCSZ2 for data size */
+    UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
     if (Config_Ptr->bit_data == UART_9_BIT)
     {
         UCSRB |= (1 << UCSZ2); /* Enable 9-bit mode */
@@ -24,94 +125,260 @@ void UART_init(const UART_ConfigType * Config_Ptr)
         UCSRC |= ((Config_Ptr->bit_data - UART_5_BIT) << UCSZ0);
     }
 
-    /* Calculate and set baud rate */
-    ubrr_value = (uint16)(((F_CPU / (Config_Ptr->baud_rate * 8UL))) - 1);
+    /* Use the precomputed UBRR for the standard rates, calculate it only for the others */
+    for (rate = 0; rate < UART_RATE_COUNT; ++rate)
+    {
+        if ((g_rateBaud[rate] == Config_Ptr->baud_rate) && (g_rateUbrr[rate] != 0))
+        {
+            ubrr_value = g_rateUbrr[rate];
+            break;
+        }
+    }
+    if (rate == UART_RATE_COUNT)
+    {
+        ubrr_value = (uint16)(((F_CPU / (Config_Ptr->baud_rate * 8UL))) - 1);
+    }
     UBRRH = ubrr_value >> 8;
     UBRRL = ubrr_value;
 }
 
 /*
  * Description :
- * Send byte through UART.
+ * Wait until every queued byte has been completely shifted out.
  */
-void UART_sendByte(const uint8 data)
+void UART_flush(void)
+{
+	while (g_txTail != g_txHead)
+	{
+		if (BIT_IS_CLEAR(SREG,7) && BIT_IS_SET(UCSRA,UDRE))
+		{
+			UART_txService();
+		}
+	}
+	/* TXC is cleared before each byte is loaded, so it is only set once the last one is out */
+	if (g_txStarted)
+	{
+		while (BIT_IS_CLEAR(UCSRA,TXC)){}
+	}
+}
+
+/*
+ * Description :
+ * Switch the baud rate to one of the standard rates.
+ */
+void UART_setRate(UART_RateType rate)
+{
+	if ((rate >= UART_RATE_COUNT) || (g_rateUbrr[rate] == 0))
+	{
+		return;
+	}
+	UART_flush();
+	UBRRH = g_rateUbrr[rate] >> 8;
+	UBRRL = g_rateUbrr[rate];
+}
+
+/*
+ * Description :
+ * Queue bytes for transmission without waiting for free space.
+ */
+uint8 UART_write(const uint8 *data, uint8 len)
 {
-	/*
-	 * UDRE flag is set when the Tx buffer (UDR) is empty and ready for
-	 * transmitting a new byte so wait until this flag is set to one
-	 */
-	while(BIT_IS_CLEAR(UCSRA,UDRE)){}
+	uint8 head = g_txHead;
+	uint8 count = 0;
 
-	/*
-	 * Put the required data in the UDR register and it also clear the UDRE flag as
-	 * the UDR register is not empty now
-	 */
-	UDR = data;
+	while ((count < len) && ((uint8)(head - g_txTail) < UART_TX_BUFFER_SIZE))
+	{
+		g_txBuffer[head & UART_TX_MASK] = data[count];
+		head++;
+		count++;
+	}
+	g_txHead = head;
 
-	/************************* Another Method *************************
-	UDR = data;
-	while(BIT_IS_CLEAR(UCSRA,TXC)){} // Wait until the transmission is complete TXC = 1
-	SET_BIT(UCSRA,TXC); // Clear the TXC flag
-	*******************************************************************/
+	/* Let the UDRE interrupt drain the buffer */
+	if (count != 0)
+	{
+		SET_BIT(UCSRB,UDRIE);
+	}
+	return count;
 }
+
 /*
  * Description :
- * Receive byte from UART.
+ * Take one received byte from the RX ring buffer without waiting.
  */
-uint8 UART_receiveByte(void)
+boolean UART_tryReceiveByte(uint8 *data)
+{
+	uint8 tail = g_rxTail;
+
+	if (tail == g_rxHead)
+	{
+		return FALSE;
+	}
+	*data = g_rxBuffer[tail & UART_RX_MASK];
+	g_rxTail = tail + 1;
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Copy received bytes out of the RX ring buffer without waiting.
+ */
+uint8 UART_read(uint8 *data, uint8 len)
 {
-	/* RXC flag is set when the UART receive data so wait until this flag is set to one */
-	while(BIT_IS_CLEAR(UCSRA,RXC)){}
+	uint8 tail = g_rxTail;
+	uint8 count = 0;
+
+	while ((count < len) && (tail != g_rxHead))
+	{
+		data[count] = g_rxBuffer[tail & UART_RX_MASK];
+		tail++;
+		count++;
+	}
+	g_rxTail = tail;
+	return count;
+}
 
-	/*
-	 * Read the received data from the Rx buffer (UDR)
-	 * The RXC flag will be cleared after read the data
-	 */
-    return UDR;
+boolean UART_isRxPending(void)
+{
+	return (g_rxHead != g_rxTail);
 }
 
+/*
+ * Description :
+ * Receive a block of bytes, giving up once the deadline passes.
+ */
+uint8 UART_receiveBlock(uint8 *buf, uint8 len, uint16 deadline)
+{
+	uint8 count = 0;
+
+	while (count < len)
+	{
+		/* Copy straight out of the RX ring as the bytes arrive */
+		count += UART_read(&buf[count], len - count);
+		if (count == len)
+		{
+			break;
+		}
+		if (BIT_IS_CLEAR(SREG,7) && BIT_IS_SET(UCSRA,RXC))
+		{
+			UART_rxService();
+		}
+		else if (Timer_isExpired(deadline))
+		{
+			break;
+		}
+		else
+		{
+			Power_idleUnless(UART_isRxPending);
+		}
+	}
+	return count;
+}
 
 /*
  * Description :
- * Send a string through UART.
+ * Read and clear the receive error counter.
  */
-void UART_sendString(const uint8 *Str)
+uint8 UART_takeErrors(void)
 {
-	uint8 i = 0;
+	uint8 errors;
+	uint8 sreg = SREG;
 
-	/* Send the whole string */
-	while(Str[i] != '\0')
+	cli();
+	errors = g_rxErrors;
+	g_rxErrors = 0;
+	SREG = sreg;
+
+	return errors;
+}
+
+/*
+ * Description :
+ * Send byte through UART.
+ */
+void UART_sendByte(const uint8 data)
+{
+	/* Wait for a free slot in the TX ring buffer */
+	while (UART_write(&data, 1) == 0)
 	{
-		UART_sendByte(Str[i]);
-		i++;
+		/*
+		 * With the global interrupts disabled the UDRE ISR can't run,
+		 * so drain the buffer by polling the UDRE flag instead
+		 */
+		if (BIT_IS_CLEAR(SREG,7) && BIT_IS_SET(UCSRA,UDRE))
+		{
+			UART_txService();
+		}
 	}
-	/************************* Another Method *************************
-	while(*Str != '\0')
+}
+
+/*
+ * Description :
+ * Receive byte from UART.
+ */
+uint8 UART_receiveByte(void)
+{
+	uint8 data;
+
+	/* Wait until the RXC ISR puts a byte in the RX ring buffer */
+	while (!UART_tryReceiveByte(&data))
 	{
-		UART_sendByte(*Str);
-		Str++;
+		/* Same as the transmitter, poll RXC when the interrupts are disabled */
+		if (BIT_IS_CLEAR(SREG,7) && BIT_IS_SET(UCSRA,RXC))
+		{
+			UART_rxService();
+		}
 	}
-	*******************************************************************/
+	return data;
 }
 
 /*
  * Description :
- * Receive a string through UART until '#' character.
+ * Send a length prefixed buffer through UART.
  */
-void UART_receiveString(uint8 *Str)
+void UART_sendBuffer(const uint8 *data, uint8 len)
 {
-	uint8 i = 0;
+	uint8 sent = 0;
 
-	/* Receive the first byte */
-	Str[i] = UART_receiveByte();
+	/* Length prefix first, then the payload copied into the TX ring in chunks */
+	UART_sendByte(len);
+	while (sent < len)
+	{
+		sent += UART_write(&data[sent], len - sent);
+		if (BIT_IS_CLEAR(SREG,7) && BIT_IS_SET(UCSRA,UDRE))
+		{
+			UART_txService();
+		}
+	}
+}
 
-	/* Receive the whole string until the '#' */
-	while(Str[i] != '#')
+/*
+ * Description :
+ * Receive a length prefixed buffer through UART, at most cap bytes are stored.
+ */
+boolean UART_receiveBuffer(uint8 *data, uint8 cap, uint8 *length, uint16 deadline)
+{
+	uint8 stored;
+	uint8 discard;
+
+	if (UART_receiveBlock(length, 1, deadline) != 1)
 	{
-		i++;
-		Str[i] = UART_receiveByte();
+		return FALSE;
+	}
+	stored = (*length < cap) ? *length : cap;
+	if (UART_receiveBlock(data, stored, deadline) != stored)
+	{
+		return FALSE;
 	}
 
-	/* After receiving the whole string plus the '#', replace the '#' with '\0' */
-	Str[i] = '\0';
+	/* Payload longer than the caller's buffer, drop the excess */
+	while (stored < *length)
+	{
+		if (UART_receiveBlock(&discard, 1, deadline) != 1)
+		{
+			return FALSE;
+		}
+		stored++;
+	}
+	return TRUE;
 }
@@ -3,6 +3,96 @@
 
 #include "std_types.h"
 
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Size of the software ring buffers used by the interrupt driven driver.
+ * Both must be a power of two (masking replaces the modulo) and at most 128
+ * so that the free running 8-bit head/tail indices can tell full from empty.
+ */
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE   32
+#endif
+
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE   32
+#endif
+
+#if (UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1)) || (UART_TX_BUFFER_SIZE > 128)
+#error "UART_TX_BUFFER_SIZE must be a power of two not greater than 128"
+#endif
+
+#if (UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) || (UART_RX_BUFFER_SIZE > 128)
+#error "UART_RX_BUFFER_SIZE must be a power of two not greater than 128"
+#endif
+
+/*
+ * Baud rate calculations for double speed mode (U2X = 1), all evaluated at compile time:
+ * UBRR = F_CPU / (8 * BAUD) - 1 rounded to the nearest integer,
+ * and the resulting baud rate error in 1/1000 units.
+ */
+#define UART_UBRR_VALUE(BAUD)        ((((F_CPU) + 4UL * (BAUD)) / (8UL * (BAUD))) - 1)
+#define UART_ACTUAL_BAUD(BAUD)       ((F_CPU) / (8UL * (UART_UBRR_VALUE(BAUD) + 1)))
+#define UART_BAUD_ERROR_PERMILLE(BAUD) \
+	((UART_ACTUAL_BAUD(BAUD) > (BAUD)) ? \
+	 ((UART_ACTUAL_BAUD(BAUD) - (BAUD)) * 1000UL / (BAUD)) : \
+	 (((BAUD) - UART_ACTUAL_BAUD(BAUD)) * 1000UL / (BAUD)))
+
+/* Maximum accepted baud rate error (2%) */
+#define UART_MAX_BAUD_ERROR_PERMILLE 20
+
+/* A rate is usable if its error is in range and UBRR fits in 12 bits */
+#define UART_BAUD_IS_USABLE(BAUD) \
+	((UART_BAUD_ERROR_PERMILLE(BAUD) < UART_MAX_BAUD_ERROR_PERMILLE) && \
+	 (UART_UBRR_VALUE(BAUD) <= 4095))
+
+/* Bit mask of the standard rates (UART_RateType) usable at this F_CPU */
+#if UART_BAUD_IS_USABLE(9600UL)
+#define UART_RATE_9600_MASK     (1 << 0)
+#else
+#define UART_RATE_9600_MASK     0
+#endif
+#if UART_BAUD_IS_USABLE(19200UL)
+#define UART_RATE_19200_MASK    (1 << 1)
+#else
+#define UART_RATE_19200_MASK    0
+#endif
+#if UART_BAUD_IS_USABLE(38400UL)
+#define UART_RATE_38400_MASK    (1 << 2)
+#else
+#define UART_RATE_38400_MASK    0
+#endif
+#if UART_BAUD_IS_USABLE(57600UL)
+#define UART_RATE_57600_MASK    (1 << 3)
+#else
+#define UART_RATE_57600_MASK    0
+#endif
+#if UART_BAUD_IS_USABLE(76800UL)
+#define UART_RATE_76800_MASK    (1 << 4)
+#else
+#define UART_RATE_76800_MASK    0
+#endif
+#if UART_BAUD_IS_USABLE(115200UL)
+#define UART_RATE_115200_MASK   (1 << 5)
+#else
+#define UART_RATE_115200_MASK   0
+#endif
+#if UART_BAUD_IS_USABLE(250000UL)
+#define UART_RATE_250000_MASK   (1 << 6)
+#else
+#define UART_RATE_250000_MASK   0
+#endif
+
+#define UART_SUPPORTED_RATES  (UART_RATE_9600_MASK | UART_RATE_19200_MASK | \
+		UART_RATE_38400_MASK | UART_RATE_57600_MASK | UART_RATE_76800_MASK | \
+		UART_RATE_115200_MASK | UART_RATE_250000_MASK)
+
+/* Both ECUs always start at 9600 baud, so it must be reachable */
+#if !UART_RATE_9600_MASK
+#error "9600 baud can't be generated within 2% at this F_CPU"
+#endif
 
 /* Define types for UART configuration */
 typedef enum {
@@ -26,6 +116,12 @@ typedef enum {
 
 typedef uint32 UART_BaudRateType;
 
+/* Standard rates that can be negotiated at runtime, index of the bit in UART_SUPPORTED_RATES */
+typedef enum {
+    UART_RATE_9600, UART_RATE_19200, UART_RATE_38400, UART_RATE_57600,
+    UART_RATE_76800, UART_RATE_115200, UART_RATE_250000, UART_RATE_COUNT
+} UART_RateType;
+
 /* Configuration structure for UART */
 typedef struct {
     UART_BitDataType bit_data;
@@ -48,27 +144,88 @@ typedef struct {
  */
 void UART_init(const UART_ConfigType * Config_Ptr);
 
+/*
+ * Description :
+ * Switch to one of the standard rates using its precomputed UBRR value.
+ * Waits until all the queued bytes are completely transmitted first.
+ */
+void UART_setRate(UART_RateType rate);
+
+/*
+ * Description :
+ * Wait until the TX ring buffer is empty and the last byte left the shift register.
+ */
+void UART_flush(void);
+
 /*
  * Description :
  * Functional responsible for send byte to another UART device.
+ * The byte is queued in the TX ring buffer, it only waits if the buffer is full.
  */
 void UART_sendByte(const uint8 data);
 
 /*
  * Description :
  * Functional responsible for receive byte from another UART device.
+ * Waits until a byte is available in the RX ring buffer.
  */
 uint8 UART_receiveByte(void);
 
 /*
  * Description :
- * Send the required string through UART to the other UART device.
+ * Queue up to len bytes for transmission without waiting.
+ * Returns the number of bytes actually queued (less than len if the TX buffer is full).
  */
-void UART_sendString(const uint8 *Str);
+uint8 UART_write(const uint8 *data, uint8 len);
 
 /*
  * Description :
- * Receive the required string until the '#' symbol through UART from the other UART device.
+ * Copy up to len received bytes from the RX ring buffer without waiting.
+ * Returns the number of bytes copied.
  */
-void UART_receiveString(uint8 *Str); // Receive until #
+uint8 UART_read(uint8 *data, uint8 len);
+
+/*
+ * Description :
+ * Take one byte from the RX ring buffer without waiting.
+ * Returns TRUE and stores the byte in data if one was available, FALSE otherwise.
+ */
+boolean UART_tryReceiveByte(uint8 *data);
+
+/*
+ * Description :
+ * Return TRUE if a received byte is waiting, the condition of Power_idleUnless.
+ */
+boolean UART_isRxPending(void);
+
+/*
+ * Description :
+ * Receive up to len bytes into buf until the deadline (Timer_getTicks value) passes.
+ * Returns the number of bytes received, len if the whole block arrived in time.
+ */
+uint8 UART_receiveBlock(uint8 *buf, uint8 len, uint16 deadline);
+
+/*
+ * Description :
+ * Return the number of framing/overrun errors and dropped bytes since the
+ * last call and clear the counter.
+ */
+uint8 UART_takeErrors(void);
+
+/*
+ * Description :
+ * Send len bytes through UART preceded by a one byte length prefix.
+ * The payload is copied into the TX ring buffer in chunks, waiting only while it is full.
+ */
+void UART_sendBuffer(const uint8 *data, uint8 len);
+
+/*
+ * Description :
+ * Receive a buffer sent by UART_sendBuffer, storing at most cap bytes in data.
+ * Bytes beyond cap are read and dropped so the stream stays in sync, length
+ * is set to the announced length.
+ * Returns FALSE if the deadline (tick count) passed before the whole buffer arrived.
+ */
+boolean UART_receiveBuffer(uint8 *data, uint8 cap, uint8 *length, uint16 deadline);
+
 #endif /* UART_H_ */
@@ -0,0 +1,115 @@
+/*
+ * Host-side benchmark for the HMI <-> Control frame parser.
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -I"Control MC" Tools/frame_bench.c "Control MC/Frame.c" "Control MC/CRC.c" -o frame_bench
+ *   ./frame_bench
+ *
+ * Encodes a stream of frames with random payload lengths, then times
+ * Frame_parseByte over the whole stream and reports frames/sec and
+ * cycles/byte (TSC cycles on x86, otherwise only ns/byte is reported).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Frame.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define BENCH_FRAMES   200000UL
+#define BENCH_ROUNDS   10
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+	uint8 payload[FRAME_MAX_PAYLOAD];
+	uint8 *stream;
+	unsigned long size = 0;
+	unsigned long frames = 0;
+	unsigned long n, k;
+	int round;
+	Frame_ParserType parser;
+	double best_ns = 0;
+#ifdef HAVE_TSC
+	unsigned long long best_cycles = 0;
+#endif
+
+	stream = malloc(BENCH_FRAMES * FRAME_MAX_SIZE);
+	if (stream == NULL)
+	{
+		return 1;
+	}
+
+	srand(1);
+	for (n = 0; n < BENCH_FRAMES; ++n)
+	{
+		uint8 length = (uint8)(rand() % (FRAME_MAX_PAYLOAD + 1));
+		for (k = 0; k < length; ++k)
+		{
+			payload[k] = (uint8)rand();
+		}
+		size += Frame_encode(&stream[size], (uint8)rand(), (uint8)n, payload, length);
+	}
+
+	for (round = 0; round < BENCH_ROUNDS; ++round)
+	{
+		double start_ns;
+		double elapsed_ns;
+#ifdef HAVE_TSC
+		unsigned long long start_cycles;
+		unsigned long long cycles;
+#endif
+		unsigned long count = 0;
+
+		Frame_parserInit(&parser);
+		start_ns = now_ns();
+#ifdef HAVE_TSC
+		start_cycles = __rdtsc();
+#endif
+		for (n = 0; n < size; ++n)
+		{
+			if (Frame_parseByte(&parser, stream[n]) == FRAME_COMPLETE)
+			{
+				count++;
+			}
+		}
+#ifdef HAVE_TSC
+		cycles = __rdtsc() - start_cycles;
+		if (round == 0 || cycles < best_cycles)
+		{
+			best_cycles = cycles;
+		}
+#endif
+		elapsed_ns = now_ns() - start_ns;
+		if (round == 0 || elapsed_ns < best_ns)
+		{
+			best_ns = elapsed_ns;
+		}
+		frames = count;
+	}
+
+	if (frames != BENCH_FRAMES)
+	{
+		printf("parser lost frames: %lu of %lu\n", BENCH_FRAMES - frames, BENCH_FRAMES);
+		return 1;
+	}
+
+	printf("frames          : %lu (%lu bytes)\n", frames, size);
+	printf("frames/sec      : %.0f\n", frames / (best_ns / 1e9));
+	printf("ns/byte         : %.2f\n", best_ns / size);
+#ifdef HAVE_TSC
+	printf("cycles/byte     : %.2f\n", (double)best_cycles / size);
+#endif
+
+	free(stream);
+	return 0;
+}
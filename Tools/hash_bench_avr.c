@@ -0,0 +1,182 @@
+/*
+ * Cycle benchmark of the password verification on the ATmega32, run under simavr.
+ *
+ * Build and run from the repository root:
+ *   avr-gcc -mmcu=atmega32 -DF_CPU=8000000UL -Os -I"Control MC" Tools/hash_bench_avr.c "Control MC/Hash.c" -o hash_bench.elf
+ *   simavr -m atmega32 -f 8000000 hash_bench.elf
+ *
+ * Timer1 counts CPU cycles (no prescaler) around each operation, the cost of
+ * reading the timer is measured first and subtracted. Every operation runs
+ * BENCH_RUNS times on different inputs and the min/max cycles are printed on
+ * the UART (simavr echoes it on the console). The verification (hash of the
+ * entered digits + digest compare) is checked against VERIFY_BUDGET_CYCLES.
+ * The CPU then sleeps with the interrupts off, which ends the simulation.
+ */
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "Hash.h"
+#include "Frame.h"
+
+#define BENCH_RUNS            64
+#define VERIFY_BUDGET_CYCLES  (F_CPU / 1000UL)   /* 1 ms of the unlock path */
+#define BENCH_BAUD            9600UL
+
+typedef struct {
+	uint16 min;
+	uint16 max;
+} Bench_ResultType;
+
+static uint8 g_salt[HASH_KEY_SIZE] = { 0x3A, 0x91, 0x5C, 0x07, 0xE4, 0x28, 0xB6, 0x6F };
+static uint8 g_stored[HASH_DIGEST_SIZE];
+static volatile boolean g_sink;
+static uint16 g_overhead = 0;
+
+static void bench_putc(char c)
+{
+	while (!(UCSRA & (1 << UDRE)));
+	UDR = c;
+}
+
+static void bench_print(const char *text)
+{
+	while (*text)
+	{
+		bench_putc(*text++);
+	}
+}
+
+static void bench_printNumber(uint32 value)
+{
+	char digits[10];
+	uint8 count = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	while (count != 0)
+	{
+		bench_putc(digits[--count]);
+	}
+}
+
+static void bench_report(const char *name, Bench_ResultType result)
+{
+	bench_print(name);
+	bench_print(": ");
+	bench_printNumber(result.min);
+	bench_print("..");
+	bench_printNumber(result.max);
+	bench_print(" cycles\r\n");
+}
+
+static void bench_update(Bench_ResultType *result, uint16 start, uint16 stop, uint8 run)
+{
+	uint16 cycles = (uint16)(stop - start - g_overhead);
+
+	if ((run == 0) || (cycles < result->min))
+	{
+		result->min = cycles;
+	}
+	if ((run == 0) || (cycles > result->max))
+	{
+		result->max = cycles;
+	}
+}
+
+/*
+ * Password check as done by Credential_endVerify: hash the entry, compare the digests.
+ */
+static boolean bench_verify(const uint8 *digits)
+{
+	uint8 digest[HASH_DIGEST_SIZE];
+
+	Hash_compute(g_salt, digits, PASS_LENGTH, digest);
+	return Hash_equal(digest, g_stored, HASH_DIGEST_SIZE);
+}
+
+int main(void)
+{
+	uint8 digits[USER_ID_LENGTH + PASS_LENGTH];
+	uint8 digest[HASH_DIGEST_SIZE];
+	Bench_ResultType empty = { 0, 0 };
+	Bench_ResultType hashPin = { 0, 0 };
+	Bench_ResultType hashUser = { 0, 0 };
+	Bench_ResultType compare = { 0, 0 };
+	Bench_ResultType verify = { 0, 0 };
+	uint16 start, stop;
+	uint8 run, i;
+
+	UBRRL = (uint8)(F_CPU / (16UL * BENCH_BAUD) - 1);
+	UCSRB = (1 << TXEN);
+	UCSRC = (1 << URSEL) | (1 << UCSZ1) | (1 << UCSZ0);
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);   /* F_CPU, 1 count per cycle */
+
+	for (i = 0; i < PASS_LENGTH; ++i)
+	{
+		digits[i] = i;
+	}
+	Hash_compute(g_salt, digits, PASS_LENGTH, g_stored);
+
+	/* Cost of the timer reads alone */
+	for (run = 0; run < BENCH_RUNS; ++run)
+	{
+		start = TCNT1;
+		stop = TCNT1;
+		bench_update(&empty, start, stop, run);
+	}
+	g_overhead = empty.min;
+
+	for (run = 0; run < BENCH_RUNS; ++run)
+	{
+		/* A different entry every run, the right PIN on run 0 */
+		for (i = 0; i < USER_ID_LENGTH + PASS_LENGTH; ++i)
+		{
+			digits[i] = (uint8)((i + run * (i + 3)) % 10);
+		}
+
+		start = TCNT1;
+		Hash_compute(g_salt, digits, PASS_LENGTH, digest);
+		stop = TCNT1;
+		bench_update(&hashPin, start, stop, run);
+
+		start = TCNT1;
+		Hash_compute(g_salt, digits, USER_ID_LENGTH + PASS_LENGTH, digest);
+		stop = TCNT1;
+		bench_update(&hashUser, start, stop, run);
+
+		start = TCNT1;
+		g_sink = Hash_equal(digest, g_stored, HASH_DIGEST_SIZE);
+		stop = TCNT1;
+		bench_update(&compare, start, stop, run);
+
+		start = TCNT1;
+		g_sink = bench_verify(digits);
+		stop = TCNT1;
+		bench_update(&verify, start, stop, run);
+	}
+
+	bench_print("HalfSipHash-2-4, F_CPU ");
+	bench_printNumber(F_CPU);
+	bench_print(" Hz, timer overhead ");
+	bench_printNumber(g_overhead);
+	bench_print(" cycles\r\n");
+	bench_report("hash PIN (5 B)    ", hashPin);
+	bench_report("hash ID+PIN (7 B) ", hashUser);
+	bench_report("digest compare    ", compare);
+	bench_report("verification      ", verify);
+	bench_print((verify.max <= VERIFY_BUDGET_CYCLES) ? "within budget of " : "OVER budget of ");
+	bench_printNumber(VERIFY_BUDGET_CYCLES);
+	bench_print(" cycles\r\n");
+
+	/* Let the last byte leave, then stop the simulation */
+	while (!(UCSRA & (1 << TXC)));
+	cli();
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	sleep_enable();
+	sleep_cpu();
+	return 0;
+}
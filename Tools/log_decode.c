@@ -0,0 +1,171 @@
+/*
+ * Host-side decoder for the Control ECU audit log export (LOG_DUMP).
+ *
+ * Build from the repository root:
+ *   gcc -O2 -DF_CPU=8000000UL -I"Control MC" Tools/log_decode.c "Control MC/Frame.c" "Control MC/CRC.c" -o log_decode
+ *
+ * Request a dump (the serial port must already be at the link baud rate):
+ *   ./log_decode --request 0 > /dev/ttyUSB0
+ * Decode the bytes captured from the Control ECU TX line to CSV:
+ *   ./log_decode capture.bin > audit.csv
+ *
+ * Frames with a bad CRC are dropped by the parser. LOG_END tells how many
+ * records the ECU sent: if some did not arrive, or the dump stopped before
+ * the end of the log, the decoder prints the offset to resume from with
+ * --request; the offsets of a resumed capture continue the same CSV.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Frame.h"
+#include "AuditLog.h"
+#include "CRC.h"
+
+static const char *event_name(uint8 event)
+{
+	switch (event)
+	{
+	case AUDIT_BOOT:            return "boot";
+	case AUDIT_ACCESS_GRANTED:  return "access_granted";
+	case AUDIT_ACCESS_DENIED:   return "access_denied";
+	case AUDIT_ALARM:           return "alarm";
+	case AUDIT_PASS_CHANGED:    return "pass_changed";
+	case AUDIT_USER_ADDED:      return "user_added";
+	case AUDIT_DOOR_CLOSED:     return "door_closed";
+	case AUDIT_ADMIN_VERIFIED:  return "admin_verified";
+	case AUDIT_DOOR_BUSY:       return "door_busy";
+	case AUDIT_DROPPED:         return "dropped";      /* user column is the number of lost events */
+	default:                    return "unknown";
+	}
+}
+
+static int request(const char *arg)
+{
+	uint8 buffer[FRAME_MAX_SIZE];
+	uint8 offset[LOG_OFFSET_LENGTH];
+	unsigned long value = strtoul(arg, NULL, 0);
+	uint8 size;
+
+	offset[0] = (uint8)value;
+	offset[1] = (uint8)(value >> 8);
+	size = Frame_encode(buffer, LOG_DUMP, 0, offset, LOG_OFFSET_LENGTH);
+	return fwrite(buffer, 1, size, stdout) == size ? 0 : 1;
+}
+
+static void print_record(unsigned long offset, const uint8 *record, unsigned long *erased, unsigned long *corrupt)
+{
+	unsigned long time;
+	uint8 i;
+
+	for (i = 0; i < AUDIT_RECORD_SIZE && record[i] == 0xFF; ++i);
+	if (i == AUDIT_RECORD_SIZE)
+	{
+		(*erased)++;   /* Slot never written */
+		return;
+	}
+	if (CRC8_compute(record, AUDIT_CRC_OFFSET) != record[AUDIT_CRC_OFFSET])
+	{
+		(*corrupt)++;
+		return;
+	}
+	time = (unsigned long)record[AUDIT_TIME_OFFSET] |
+			((unsigned long)record[AUDIT_TIME_OFFSET + 1] << 8) |
+			((unsigned long)record[AUDIT_TIME_OFFSET + 2] << 16);
+	printf("%lu,%u,%s,%u,%lu\n", offset, record[AUDIT_SEQUENCE_OFFSET],
+			event_name(record[AUDIT_EVENT_OFFSET]),
+			record[AUDIT_USER_OFFSET] | (record[AUDIT_USER_OFFSET + 1] << 8), time);
+}
+
+int main(int argc, char **argv)
+{
+	Frame_ParserType parser;
+	Frame_Type *frame = &parser.frame;
+	FILE *input = stdin;
+	unsigned long expected = 0;
+	unsigned long offset;
+	unsigned long erased = 0, corrupt = 0, dropped = 0;
+	unsigned long sent = 0, received = 0;
+	int ended = 0;
+	int started = 0;
+	int c;
+	uint8 n, records;
+
+	if (argc == 3 && strcmp(argv[1], "--request") == 0)
+	{
+		return request(argv[2]);
+	}
+	if (argc == 2 && strcmp(argv[1], "-") != 0)
+	{
+		input = fopen(argv[1], "rb");
+		if (input == NULL)
+		{
+			perror(argv[1]);
+			return 1;
+		}
+	}
+	else if (argc > 2)
+	{
+		fprintf(stderr, "usage: %s [capture.bin | --request OFFSET]\n", argv[0]);
+		return 1;
+	}
+
+	printf("offset,sequence,event,user,time_s\n");
+	Frame_parserInit(&parser);
+	while ((c = fgetc(input)) != EOF)
+	{
+		switch (Frame_parseByte(&parser, (uint8)c))
+		{
+		case FRAME_CRC_ERROR:
+			dropped++;
+			continue;
+		case FRAME_INCOMPLETE:
+			continue;
+		default:
+			break;
+		}
+
+		if (frame->type == LOG_END && frame->length == LOG_OFFSET_LENGTH)
+		{
+			sent += frame->payload[0] | ((unsigned long)frame->payload[1] << 8);
+			ended = 1;
+			continue;
+		}
+		if (frame->type != LOG_DATA || frame->length < LOG_OFFSET_LENGTH ||
+			((frame->length - LOG_OFFSET_LENGTH) % AUDIT_RECORD_SIZE) != 0)
+		{
+			continue;   /* Other traffic on the line */
+		}
+
+		offset = frame->payload[0] | ((unsigned long)frame->payload[1] << 8);
+		if (!started)
+		{
+			expected = offset;   /* A resumed dump starts where the last one stopped */
+			started = 1;
+		}
+		if (offset != expected)
+		{
+			fprintf(stderr, "records %lu..%lu missing, resume with --request %lu\n",
+					expected, offset - 1, expected);
+		}
+		records = (frame->length - LOG_OFFSET_LENGTH) / AUDIT_RECORD_SIZE;
+		received += records;
+		for (n = 0; n < records; ++n)
+		{
+			print_record(offset + n, &frame->payload[LOG_OFFSET_LENGTH + n * AUDIT_RECORD_SIZE],
+					&erased, &corrupt);
+		}
+		if (offset + records > expected)
+		{
+			expected = offset + records;
+		}
+	}
+
+	fprintf(stderr, "%lu frames dropped (CRC), %lu empty slots, %lu damaged records\n",
+			dropped, erased, corrupt);
+	if (!ended || received < sent || expected < AUDIT_LOG_SLOTS)
+	{
+		fprintf(stderr, "dump incomplete, resume with --request %lu\n", expected);
+		return 2;
+	}
+	return 0;
+}
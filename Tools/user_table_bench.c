@@ -0,0 +1,160 @@
+/*
+ * Host-side benchmark for the Control ECU user table (UserTable.c).
+ *
+ * Build and run from the repository root:
+ *   gcc -O2 -DF_CPU=8000000UL -DUSER_TABLE_SLOTS=2048 -I"Control MC" Tools/user_table_bench.c "Control MC/UserTable.c" "Control MC/Hash.c" "Control MC/CRC.c" -o user_table_bench
+ *   ./user_table_bench
+ *
+ * The EEPROM driver is replaced by a RAM stub that counts the accesses.
+ * USER_TABLE_SLOTS defaults to what fits in the 24C16 (128 slots, 96 users),
+ * the build above uses a bigger table so 1000 users fit.
+ *
+ * For 10, 100 and 1000 users it reports the EEPROM reads per PASS_IN check
+ * (correct and wrong PIN), the estimated bus time of those reads at
+ * TWI_SCL_FREQ, and the host CPU time of a lookup.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "UserTable.h"
+
+#define BENCH_LOOKUPS    100000UL
+#define STUB_SIZE        0x10000UL
+
+static uint8 g_eeprom[STUB_SIZE];
+static unsigned long g_reads = 0;
+static unsigned long g_readBytes = 0;
+
+/*******************************************************************************
+ *                              EEPROM stub                                    *
+ *******************************************************************************/
+
+uint8 EEPROM_readBlock(uint16 u16addr, uint8 *data, uint16 len)
+{
+	memcpy(data, &g_eeprom[u16addr], len);
+	g_reads++;
+	g_readBytes += len;
+	return SUCCESS;
+}
+
+uint8 EEPROM_writeBlock(uint16 u16addr, const uint8 *data, uint16 len)
+{
+	memcpy(&g_eeprom[u16addr], data, len);
+	return SUCCESS;
+}
+
+uint8 EEPROM_writeByte(uint16 u16addr, uint8 u8data)
+{
+	g_eeprom[u16addr] = u8data;
+	return SUCCESS;
+}
+
+/*******************************************************************************
+ *                                Benchmark                                    *
+ *******************************************************************************/
+
+static unsigned long g_seed = 1;
+
+static unsigned long bench_rand(void)
+{
+	g_seed = g_seed * 1103515245UL + 12345UL;
+	return (g_seed >> 16) & 0x7FFF;
+}
+
+static void user_pin(uint16 user, uint8 *pin)
+{
+	uint8 i;
+	for (i = 0; i < PASS_LENGTH; ++i)
+	{
+		pin[i] = (uint8)((user * 7 + i * 3 + user / 10) % 10);
+	}
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Bus time of a random read on a 24Cxx: START, SLA+W, word address,
+ * repeated START, SLA+R, the data bytes and STOP, 9 clocks per byte.
+ */
+static double read_us(unsigned long reads, unsigned long bytes)
+{
+	double clocks = reads * (3 * 9 + 2) + bytes * 9.0;
+	return clocks * 1e6 / TWI_SCL_FREQ;
+}
+
+static void bench(uint16 users)
+{
+	uint8 pin[PASS_LENGTH];
+	unsigned long n;
+	unsigned long reads, bytes, maxReads = 0;
+	unsigned long hits = 0;
+	uint16 user;
+	double start, elapsed;
+	int wrong;
+
+	memset(g_eeprom, USER_STATE_EMPTY, sizeof(g_eeprom));
+	while (!Hash_isSeeded())
+	{
+		Hash_addEntropy((uint8)clock());
+	}
+	UserTable_init();
+	for (user = 1; user <= users; ++user)
+	{
+		user_pin(user, pin);
+		if (UserTable_add(user, pin) != SUCCESS)
+		{
+			printf("%5u users: table full at %u (max %lu)\n", users, user, (unsigned long)USER_TABLE_MAX_USERS);
+			return;
+		}
+	}
+
+	/* Boot time index build */
+	g_reads = g_readBytes = 0;
+	UserTable_init();
+	printf("%5u users: index build %lu reads (%.1f ms bus)\n",
+			users, g_reads, read_us(g_reads, g_readBytes) / 1000.0);
+
+	for (wrong = 0; wrong <= 1; ++wrong)
+	{
+		reads = bytes = maxReads = 0;
+		hits = 0;
+		g_seed = 1;
+		start = now_ns();
+		for (n = 0; n < BENCH_LOOKUPS; ++n)
+		{
+			user = (uint16)(1 + bench_rand() % users);
+			user_pin(user, pin);
+			if (wrong)
+			{
+				pin[n % PASS_LENGTH] = (uint8)((pin[n % PASS_LENGTH] + 1) % 10);
+			}
+			g_reads = g_readBytes = 0;
+			hits += UserTable_verify(user, pin);
+			reads += g_reads;
+			bytes += g_readBytes;
+			if (g_reads > maxReads)
+			{
+				maxReads = g_reads;
+			}
+		}
+		elapsed = now_ns() - start;
+		printf("             %s PIN: %.3f reads avg, %lu max, %.0f us bus avg, %.1f ns host, %lu/%lu accepted\n",
+				wrong ? "wrong  " : "correct", (double)reads / BENCH_LOOKUPS, maxReads,
+				read_us(reads, bytes) / BENCH_LOOKUPS, elapsed / BENCH_LOOKUPS, hits, BENCH_LOOKUPS);
+	}
+}
+
+int main(void)
+{
+	printf("%u slots, %lu users max, SCL %lu Hz\n",
+			(unsigned)USER_TABLE_SLOTS, (unsigned long)USER_TABLE_MAX_USERS, (unsigned long)TWI_SCL_FREQ);
+	bench(10);
+	bench(100);
+	bench(1000);
+	return 0;
+}